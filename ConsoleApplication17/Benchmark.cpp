@@ -0,0 +1,148 @@
+// Microbenchmarks for runtime building blocks, built with -DRUNTIME_BUILD_BENCHMARKS=ON.
+// usage: RuntimeBenchmarks [name...]  -- runs every benchmark when no name is given
+#include "Runtime.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double Seconds(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void Check(bool ok, const char* what) {
+	if (!ok) {
+		printf("FAILED: %s\n", what);
+		exit(1);
+	}
+}
+
+// one record: an int, a double and a string, like a serialized Ctor constant
+void Bench_ByteStream() {
+	const int records = 1000000;
+	const int rounds = 10;
+	std::string payloads[] = { "", "x", "short string", std::string(200, 'a') + std::string(200, 'b') };
+
+	ByteWriter writer;
+	double writeTime = 0;
+	for (int round = 0; round < rounds; ++round) {
+		writer.Clear();
+		auto start = Clock::now();
+		writer.Reserve(records * (sizeof(int64_t) + sizeof(double) + sizeof(size_t) + 64));
+		for (int i = 0; i < records; ++i) {
+			writer.Write<int64_t>(i);
+			writer.Write<double>(i * 0.5);
+			writer.Write(payloads[i % 4]);
+		}
+		writeTime += Seconds(start);
+	}
+
+	double readTime = 0;
+	size_t checksum = 0;
+	for (int round = 0; round < rounds; ++round) {
+		auto start = Clock::now();
+		ByteStream stream(writer.GetBuffer());
+		for (int i = 0; i < records; ++i) {
+			checksum += stream.Read<int64_t>();
+			checksum += (size_t)stream.Read<double>();
+			checksum += stream.ReadString().size();
+		}
+		readTime += Seconds(start);
+		Check(stream.IsEnd() && !stream.IsFailed(), "stream consumed exactly");
+	}
+
+	ByteStream stream(writer.GetBuffer());
+	for (int i = 0; i < 4; ++i) {
+		stream.Read<int64_t>();
+		stream.Read<double>();
+		Check(stream.ReadString() == payloads[i], "strings round-trip in order");
+	}
+	ByteStream truncated(std::span<const uint8_t>(writer.GetBuffer().data(), 3));
+	Check(truncated.Read<int64_t>() == 0 && truncated.IsFailed(), "truncated read fails");
+
+	double mb = writer.GetSize() * (double)rounds / (1024 * 1024);
+	printf("bytestream: %.1f MB, write %.0f MB/s, read %.0f MB/s (checksum %zu)\n", mb / rounds, mb / writeTime, mb / readTime, checksum);
+}
+
+// CreateVar/ReturnVar through an executor: steady churn, bursts released LIFO, and a FIFO window
+void Bench_VarPool() {
+	RuntimeCtx ctx;
+	RuntimeExecutor exec;
+	const int ops = 10000000;
+
+	auto start = Clock::now();
+	for (int i = 0; i < ops; ++i) {
+		exec.ReturnVar(&ctx, exec.CreateVar(&ctx));
+	}
+	double churn = Seconds(start);
+
+	const int burst = 100000;
+	std::vector<RuntimeVar*> vars(burst);
+	auto runBursts = [&]() {
+		auto start = Clock::now();
+		for (int round = 0; round < ops / burst; ++round) {
+			for (auto& var : vars) {
+				var = exec.CreateVar(&ctx);
+			}
+			for (int i = burst; i-- > 0;) {
+				exec.ReturnVar(&ctx, vars[i]);
+			}
+		}
+		return Seconds(start);
+	};
+	// default policy trims the chunks above the retained capacity after every burst, Manual keeps them
+	double bursts = runBursts();
+	VarPoolStats burstStats = exec.GetPoolStats();
+	exec.SetPoolPolicy({ EVarPoolTrim::Manual });
+	double manualBursts = runBursts();
+	exec.TrimPool();
+	exec.SetPoolPolicy({});
+
+	const size_t window = 1024;
+	std::vector<RuntimeVar*> ring(window);
+	for (auto& var : ring) {
+		var = exec.CreateVar(&ctx);
+	}
+	start = Clock::now();
+	for (int i = 0; i < ops; ++i) {
+		RuntimeVar*& slot = ring[i % window];
+		exec.ReturnVar(&ctx, slot);
+		slot = exec.CreateVar(&ctx);
+	}
+	double fifo = Seconds(start);
+	for (auto var : ring) {
+		exec.ReturnVar(&ctx, var);
+	}
+
+	// every op is one CreateVar plus one ReturnVar
+	printf("varpool: churn %.1f ns/op, burst %.1f ns/op (%.1f with manual trim), fifo window %.1f ns/op\n",
+		churn * 1e9 / ops, bursts * 1e9 / ops, manualBursts * 1e9 / ops, fifo * 1e9 / ops);
+	printf("varpool: bursts peaked at %zu vars of capacity, trimmed %zu chunks, kept %zu\n", burstStats.peakCapacity, burstStats.trimmedChunks, burstStats.capacity);
+}
+
+struct Benchmark {
+	const char* name;
+	void (*run)();
+};
+
+const Benchmark benchmarks[] = {
+	{ "bytestream", Bench_ByteStream },
+	{ "varpool", Bench_VarPool },
+};
+
+}
+
+int main(int argc, char** argv) {
+	for (auto& bench : benchmarks) {
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; ++i) {
+			selected |= std::string_view(argv[i]) == bench.name;
+		}
+		if (selected)
+			bench.run();
+	}
+	return 0;
+}
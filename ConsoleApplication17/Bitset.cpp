@@ -0,0 +1,94 @@
+#include "Bitset.h"
+#include <bit>
+#ifdef RUNTIME_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// dst[i] = Op(dst[i], src[i]), two words per vector
+template<typename Op>
+void CombineWords(uint64_t* dst, const uint64_t* src, size_t count) {
+	size_t i = 0;
+#ifdef RUNTIME_SSE2
+	for (; i + 2 <= count; i += 2) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), Op::Vec(a, b));
+	}
+#endif
+	for (; i < count; ++i) {
+		dst[i] = Op::Word(dst[i], src[i]);
+	}
+}
+
+struct AndOp {
+	static uint64_t Word(uint64_t a, uint64_t b) { return a & b; }
+#ifdef RUNTIME_SSE2
+	static __m128i Vec(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+#endif
+};
+struct OrOp {
+	static uint64_t Word(uint64_t a, uint64_t b) { return a | b; }
+#ifdef RUNTIME_SSE2
+	static __m128i Vec(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+#endif
+};
+struct XorOp {
+	static uint64_t Word(uint64_t a, uint64_t b) { return a ^ b; }
+#ifdef RUNTIME_SSE2
+	static __m128i Vec(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+#endif
+};
+struct AndNotOp {
+	static uint64_t Word(uint64_t a, uint64_t b) { return a & ~b; }
+#ifdef RUNTIME_SSE2
+	static __m128i Vec(__m128i a, __m128i b) { return _mm_andnot_si128(b, a); }
+#endif
+};
+
+}
+
+size_t RuntimeBitset::Count() const {
+	const uint64_t* words = this->words.data();
+	size_t count = this->words.size();
+	size_t i = 0;
+	size_t total = 0;
+#ifdef RUNTIME_SSE2
+	// baseline x86-64 has no popcnt instruction: count bytes in parallel and let psadbw add them up
+	const __m128i m1 = _mm_set1_epi8(0x55);
+	const __m128i m2 = _mm_set1_epi8(0x33);
+	const __m128i m4 = _mm_set1_epi8(0x0F);
+	__m128i sum = _mm_setzero_si128();
+	for (; i + 2 <= count; i += 2) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+		v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi64(v, 1), m1));
+		v = _mm_add_epi8(_mm_and_si128(v, m2), _mm_and_si128(_mm_srli_epi64(v, 2), m2));
+		v = _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi64(v, 4)), m4);
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(v, _mm_setzero_si128()));
+	}
+	uint64_t lanes[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sum);
+	total = lanes[0] + lanes[1];
+#endif
+	for (; i < count; ++i) {
+		total += std::popcount(words[i]);
+	}
+	return total;
+}
+
+void RuntimeBitset::And(const RuntimeBitset& other) {
+	CombineWords<AndOp>(this->words.data(), other.words.data(), this->words.size());
+}
+
+void RuntimeBitset::Or(const RuntimeBitset& other) {
+	CombineWords<OrOp>(this->words.data(), other.words.data(), this->words.size());
+}
+
+void RuntimeBitset::Xor(const RuntimeBitset& other) {
+	CombineWords<XorOp>(this->words.data(), other.words.data(), this->words.size());
+}
+
+void RuntimeBitset::AndNot(const RuntimeBitset& other) {
+	CombineWords<AndNotOp>(this->words.data(), other.words.data(), this->words.size());
+}
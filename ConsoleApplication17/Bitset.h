@@ -0,0 +1,30 @@
+#pragma once
+#include "Runtime.h"
+
+// Packed flags held by Bitset vars, one bit each where an Array of Int64 spends a whole var per flag. Bits past
+// Size() in the last word stay zero, so Count and the bulk operations work on whole words without masking.
+class RuntimeBitset {
+public:
+	explicit RuntimeBitset(size_t bits_) : bits(bits_), words((bits_ + 63) / 64) {}
+
+	size_t Size() const { return this->bits; }
+	bool Test(size_t idx) const { return (this->words[idx / 64] >> (idx % 64)) & 1; }
+	void Set(size_t idx) { this->words[idx / 64] |= 1ull << (idx % 64); }
+	void Clear(size_t idx) { this->words[idx / 64] &= ~(1ull << (idx % 64)); }
+	// bits set
+	size_t Count() const;
+
+	// this = this op other, for bitsets of the same size
+	void And(const RuntimeBitset& other);
+	void Or(const RuntimeBitset& other);
+	void Xor(const RuntimeBitset& other);
+	void AndNot(const RuntimeBitset& other);
+
+	const std::vector<uint64_t>& GetWords() const { return this->words; }
+	// heap bytes, the bitset itself included, for MemoryUsage
+	size_t GetBytes() const { return sizeof(RuntimeBitset) + this->words.capacity() * sizeof(uint64_t); }
+
+private:
+	size_t bits;
+	std::vector<uint64_t> words;
+};
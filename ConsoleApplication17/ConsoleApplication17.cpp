@@ -7,9 +7,11 @@
 #include <sstream>
 #include <climits>
 #include <set>
+#include <charconv>
 #include "Stream.h"
 #include "Lexeme.h"
 #include "OCompiler.h"
+#include "PassManager.h"
 
 #include "Poliz.h"
 
@@ -26,9 +28,59 @@ using std::exception;
 //    return c;
 //}
 
-int main()
+int main(int argc, char** argv)
 {
+	EOptLevel optLevel = EOptLevel::O2;
+	bool autoMemo = false;
+	EGcMode gcMode = EGcMode::Full;
+	size_t memoryLimit = 0;
+	std::set<string> disabledPasses;
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "-O0")
+			optLevel = EOptLevel::O0;
+		else if (arg == "-O1")
+			optLevel = EOptLevel::O1;
+		else if (arg == "-O2")
+			optLevel = EOptLevel::O2;
+		else if (arg == "-memo")
+			autoMemo = true;
+		else if (arg == "-gc=off")
+			gcMode = EGcMode::Off;
+		else if (arg == "-gc=full")
+			gcMode = EGcMode::Full;
+		else if (arg == "-gc=incremental")
+			gcMode = EGcMode::Incremental;
+		else if (arg.rfind("-mem=", 0) == 0) {
+			const char* first = arg.data() + 5;
+			const char* last = arg.data() + arg.size();
+			auto [end, ec] = std::from_chars(first, last, memoryLimit);
+			if (ec != std::errc() || end != last) {
+				cout << "Invalid option " << arg << ", expected -mem=<bytes>" << endl;
+				return 1;
+			}
+		}
+		else if (arg.rfind("-no-pass=", 0) == 0) {
+			string pass = arg.substr(9);
+			if (!PassManager::CreateDefault(EOptLevel::O2).HasPass(pass)) {
+				cout << "Unknown pass " << pass << " in " << arg << endl;
+				return 1;
+			}
+			disabledPasses.insert(pass);
+		}
+		else {
+			cout << "Unknown option " << arg << ", expected -O0, -O1, -O2, -memo, -gc=off|full|incremental, -mem=<bytes> or -no-pass=<pass>" << endl;
+			return 1;
+		}
+	}
+
 	Compiler compiler = Compiler();
+	compiler.SetOptLevel(optLevel);
+	compiler.SetAutoMemo(autoMemo);
+	compiler.SetGcMode(gcMode);
+	compiler.SetMemoryLimit(memoryLimit);
+	for (const string& pass : disabledPasses)
+		compiler.DisablePass(pass);
 	CompilationResult* result = compiler.Compile("../input.txt");
 //	if (result->GetString().find("Failed to read")) {
 //		delete result;
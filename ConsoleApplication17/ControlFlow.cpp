@@ -0,0 +1,215 @@
+#include "ControlFlow.h"
+
+ControlFlowGraph::ControlFlowGraph(const std::vector<RuntimeInstr>& code) {
+	const int64_t size = code.size();
+	std::set<int64_t> leaders = { 0 };
+	std::set<int64_t> targets;
+	for (int64_t i = 0; i < size; ++i) {
+		if (code[i].IsJump()) {
+			for (int64_t delta : code[i].GetJumpDeltas()) {
+				targets.insert(i + 1 + delta);
+				leaders.insert(i + 1 + delta);
+			}
+			leaders.insert(i + 1);
+		}
+		else if (code[i].opcode == RuntimeInstrType::Ret) {
+			leaders.insert(i + 1);
+		}
+	}
+
+	std::map<int64_t, int> blockAt;
+	for (int64_t start : leaders) {
+		if (start > size || (start == size && start != 0 && !targets.count(size)))
+			continue;
+		int id = this->blocks.size();
+		this->blocks.emplace_back(id);
+		this->layout.push_back(id);
+		blockAt[start] = id;
+	}
+
+	for (auto it = blockAt.begin(); it != blockAt.end(); ++it) {
+		BasicBlock& block = this->blocks[it->second];
+		auto next = std::next(it);
+		int64_t end = next == blockAt.end() ? size : next->first;
+		for (int64_t i = it->first; i < end; ++i) {
+			block.instrs.push_back(code[i]);
+		}
+
+		int nextBlock = next == blockAt.end() ? -1 : next->second;
+		if (block.instrs.empty()) {
+			block.fallthrough = nextBlock;
+			continue;
+		}
+		const RuntimeInstr& last = block.instrs.back();
+		if (last.IsJump()) {
+			std::vector<int64_t> deltas = last.GetJumpDeltas();
+			block.jumpTarget = blockAt[end + deltas[0]];
+			for (size_t k = 1; k < deltas.size(); ++k) {
+				block.caseTargets.push_back(blockAt[end + deltas[k]]);
+			}
+			block.fallthrough = last.IsConditionalJump() ? nextBlock : -1;
+		}
+		else if (last.opcode != RuntimeInstrType::Ret) {
+			block.fallthrough = nextBlock;
+		}
+	}
+	this->Analyze();
+}
+
+int ControlFlowGraph::InsertBlock(size_t layoutPos) {
+	int id = this->blocks.size();
+	this->blocks.emplace_back(id);
+	this->layout.insert(this->layout.begin() + layoutPos, id);
+	return id;
+}
+
+size_t ControlFlowGraph::GetLayoutPos(int id) const {
+	return std::find(this->layout.begin(), this->layout.end(), id) - this->layout.begin();
+}
+
+void ControlFlowGraph::Analyze() {
+	const size_t count = this->blocks.size();
+	for (auto& block : this->blocks) {
+		block.preds.clear();
+	}
+	for (auto& block : this->blocks) {
+		for (int succ : block.GetSuccessors()) {
+			this->blocks[succ].preds.push_back(block.id);
+		}
+	}
+
+	this->reachable.assign(count, false);
+	std::vector<int> work = { this->GetEntry() };
+	this->reachable[this->GetEntry()] = true;
+	while (!work.empty()) {
+		int id = work.back();
+		work.pop_back();
+		for (int succ : this->blocks[id].GetSuccessors()) {
+			if (!this->reachable[succ]) {
+				this->reachable[succ] = true;
+				work.push_back(succ);
+			}
+		}
+	}
+
+	// iterative dataflow, blocks are few
+	this->dominators.assign(count, std::vector<bool>(count, true));
+	this->dominators[this->GetEntry()].assign(count, false);
+	this->dominators[this->GetEntry()][this->GetEntry()] = true;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (int id : this->layout) {
+			if (id == this->GetEntry() || !this->reachable[id])
+				continue;
+			std::vector<bool> dom(count, true);
+			for (int pred : this->blocks[id].preds) {
+				if (!this->reachable[pred])
+					continue;
+				for (size_t i = 0; i < count; ++i) {
+					dom[i] = dom[i] && this->dominators[pred][i];
+				}
+			}
+			dom[id] = true;
+			if (dom != this->dominators[id]) {
+				this->dominators[id] = dom;
+				changed = true;
+			}
+		}
+	}
+
+	// the immediate dominator is the strict dominator dominated by all the others
+	this->idom.assign(count, -1);
+	for (int id : this->layout) {
+		if (id == this->GetEntry() || !this->reachable[id])
+			continue;
+		for (int d = 0; d < (int)count; ++d) {
+			if (d == id || !this->dominators[id][d])
+				continue;
+			if (this->idom[id] < 0 || this->Dominates(this->idom[id], d))
+				this->idom[id] = d;
+		}
+	}
+
+	this->loops.clear();
+	std::map<int, size_t> loopOf;
+	for (int id : this->layout) {
+		if (!this->reachable[id])
+			continue;
+		for (int succ : this->blocks[id].GetSuccessors()) {
+			if (!this->Dominates(succ, id))
+				continue;
+			// back edge id -> succ
+			auto found = loopOf.find(succ);
+			if (found == loopOf.end()) {
+				found = loopOf.emplace(succ, this->loops.size()).first;
+				Loop loop;
+				loop.header = succ;
+				loop.blocks.insert(succ);
+				this->loops.push_back(loop);
+			}
+			Loop& loop = this->loops[found->second];
+			loop.latches.push_back(id);
+			std::vector<int> stack = { id };
+			while (!stack.empty()) {
+				int cur = stack.back();
+				stack.pop_back();
+				if (!loop.blocks.insert(cur).second)
+					continue;
+				for (int pred : this->blocks[cur].preds) {
+					if (this->reachable[pred])
+						stack.push_back(pred);
+				}
+			}
+		}
+	}
+}
+
+std::vector<RuntimeInstr> ControlFlowGraph::Flatten() const {
+	// a Jmp to the next block is dropped, a fallthrough to a block that is not next gets a Jmp
+	auto layoutNext = [&](size_t pos) -> int {
+		return pos + 1 < this->layout.size() ? this->layout[pos + 1] : -1;
+	};
+	auto emittedSize = [&](size_t pos) -> size_t {
+		const BasicBlock& block = this->blocks[this->layout[pos]];
+		size_t sz = block.instrs.size();
+		if (sz && block.instrs.back().opcode == RuntimeInstrType::Jmp && block.jumpTarget == layoutNext(pos))
+			sz -= 1;
+		if (block.fallthrough >= 0 && block.fallthrough != layoutNext(pos))
+			sz += 1;
+		return sz;
+	};
+
+	std::vector<int64_t> start(this->blocks.size(), 0);
+	int64_t offset = 0;
+	for (size_t pos = 0; pos < this->layout.size(); ++pos) {
+		start[this->layout[pos]] = offset;
+		offset += emittedSize(pos);
+	}
+
+	std::vector<RuntimeInstr> code;
+	code.reserve(offset);
+	for (size_t pos = 0; pos < this->layout.size(); ++pos) {
+		const BasicBlock& block = this->blocks[this->layout[pos]];
+		for (size_t i = 0; i < block.instrs.size(); ++i) {
+			RuntimeInstr instr = block.instrs[i];
+			if (i + 1 == block.instrs.size() && instr.IsJump()) {
+				if (instr.opcode == RuntimeInstrType::Jmp && block.jumpTarget == layoutNext(pos))
+					continue;
+				int64_t next = (int64_t)code.size() + 1;
+				std::vector<int64_t> deltas = { start[block.jumpTarget] - next };
+				for (int target : block.caseTargets) {
+					deltas.push_back(start[target] - next);
+				}
+				instr.SetJumpDeltas(deltas);
+			}
+			code.push_back(instr);
+		}
+		if (block.fallthrough >= 0 && block.fallthrough != layoutNext(pos)) {
+			RuntimeInstr jmp(RuntimeInstrType::Jmp);
+			jmp.AddParam<int64_t>(start[block.fallthrough] - (int64_t)code.size() - 1);
+			code.push_back(jmp);
+		}
+	}
+	return code;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "Runtime.h"
+
+struct BasicBlock {
+	int id;
+	std::vector<RuntimeInstr> instrs; // a jump, if present, is always the last instruction
+	int fallthrough; // -1 after Jmp and Ret
+	int jumpTarget; // -1 unless the block ends with a jump; the default case of a Switch
+	std::vector<int> caseTargets; // one per slot of the Switch table
+	std::vector<int> preds;
+
+	BasicBlock(int id_) : id(id_), fallthrough(-1), jumpTarget(-1) {}
+
+	std::vector<int> GetSuccessors() const {
+		std::vector<int> succ;
+		if (this->fallthrough >= 0) succ.push_back(this->fallthrough);
+		if (this->jumpTarget >= 0 && this->jumpTarget != this->fallthrough) succ.push_back(this->jumpTarget);
+		for (int target : this->caseTargets) {
+			if (std::find(succ.begin(), succ.end(), target) == succ.end()) succ.push_back(target);
+		}
+		return succ;
+	}
+};
+
+struct Loop {
+	int header;
+	std::set<int> blocks;
+	std::vector<int> latches; // blocks with a back edge to the header
+};
+
+// Basic blocks of a lowered method. Jump deltas are resolved to block ids on construction and
+// recomputed from the layout by Flatten, so passes may move instructions and insert blocks freely.
+class ControlFlowGraph {
+public:
+	explicit ControlFlowGraph(const std::vector<RuntimeInstr>& code);
+
+	std::vector<RuntimeInstr> Flatten() const;
+
+	// preds, dominators and natural loops; call again after changing edges
+	void Analyze();
+
+	BasicBlock& GetBlock(int id) { return this->blocks[id]; }
+	const BasicBlock& GetBlock(int id) const { return this->blocks[id]; }
+	const std::vector<int>& GetLayout() const { return this->layout; }
+	const std::vector<Loop>& GetLoops() const { return this->loops; }
+	int GetEntry() const { return this->layout.front(); }
+	size_t GetBlockCount() const { return this->blocks.size(); }
+
+	int InsertBlock(size_t layoutPos);
+	size_t GetLayoutPos(int id) const;
+	bool IsReachable(int id) const { return this->reachable[id]; }
+	bool Dominates(int a, int b) const { return this->dominators[b][a]; }
+	int GetImmediateDominator(int id) const { return this->idom[id]; } // -1 for the entry and unreachable blocks
+
+private:
+	std::vector<BasicBlock> blocks;
+	std::vector<int> layout;
+
+	std::vector<bool> reachable;
+	std::vector<std::vector<bool>> dominators; // dominators[b][a]: a dominates b
+	std::vector<int> idom;
+	std::vector<Loop> loops;
+};
@@ -0,0 +1,22 @@
+#include "Deque.h"
+
+void RuntimeDeque::Reserve(size_t count) {
+	if (count <= this->capacity)
+		return;
+	size_t newCapacity = this->NextCapacity();
+	while (newCapacity < count) {
+		newCapacity *= 2;
+	}
+	this->Resize(newCapacity);
+}
+
+void RuntimeDeque::Resize(size_t newCapacity) {
+	RuntimeVar** newSlots = new RuntimeVar*[newCapacity];
+	for (size_t i = 0; i < this->size; ++i) {
+		newSlots[i] = this->At(i);
+	}
+	delete[] this->slots;
+	this->slots = newSlots;
+	this->capacity = newCapacity;
+	this->head = 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "Runtime.h"
+
+// Ring buffer held by Deque vars: elements live at head, head + 1, ... modulo a power-of-two capacity, so both ends
+// push and pop in O(1) and positional access is one mask away. A full buffer doubles, unwrapping the elements to
+// the front of the new one. Elements are vars owned by the deque.
+class RuntimeDeque {
+public:
+	RuntimeDeque() : slots(nullptr), capacity(0), head(0), size(0) {}
+	RuntimeDeque(const RuntimeDeque&) = delete;
+	RuntimeDeque& operator=(const RuntimeDeque&) = delete;
+	~RuntimeDeque() { delete[] this->slots; }
+
+	size_t Size() const { return this->size; }
+	// idx-th element from the front
+	RuntimeVar* At(size_t idx) const { return this->slots[(this->head + idx) & (this->capacity - 1)]; }
+
+	bool IsFull() const { return this->size == this->capacity; }
+	// capacity bytes the next Grow adds, for MemoryUsage
+	size_t GrowBytes() const { return this->NextCapacity() * sizeof(RuntimeVar*) - this->capacity * sizeof(RuntimeVar*); }
+	void Grow() { this->Resize(this->NextCapacity()); }
+	// room for count elements without another Grow
+	void Reserve(size_t count);
+
+	// the push functions expect room, see IsFull; the pop functions expect elements
+	void PushBack(RuntimeVar* var) {
+		this->slots[(this->head + this->size) & (this->capacity - 1)] = var;
+		this->size += 1;
+	}
+	void PushFront(RuntimeVar* var) {
+		this->head = (this->head - 1) & (this->capacity - 1);
+		this->slots[this->head] = var;
+		this->size += 1;
+	}
+	RuntimeVar* PopBack() {
+		this->size -= 1;
+		return this->At(this->size);
+	}
+	RuntimeVar* PopFront() {
+		RuntimeVar* var = this->slots[this->head];
+		this->head = (this->head + 1) & (this->capacity - 1);
+		this->size -= 1;
+		return var;
+	}
+
+	// heap bytes, the deque itself included, for MemoryUsage
+	size_t GetBytes() const { return sizeof(RuntimeDeque) + this->capacity * sizeof(RuntimeVar*); }
+
+private:
+	static constexpr size_t minCapacity = 8;
+
+	RuntimeVar** slots;
+	size_t capacity; // 0 or a power of two, at least minCapacity
+	size_t head;
+	size_t size;
+
+	size_t NextCapacity() const { return this->capacity ? this->capacity * 2 : minCapacity; }
+	void Resize(size_t newCapacity);
+};
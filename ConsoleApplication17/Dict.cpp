@@ -0,0 +1,194 @@
+#include "Dict.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#ifdef RUNTIME_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// bit i set for every control byte of the group equal to value
+inline uint32_t MatchGroup(const int8_t* group, int8_t value) {
+#ifdef RUNTIME_SSE2
+	__m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value)));
+#else
+	uint32_t mask = 0;
+	for (int i = 0; i < 16; ++i) {
+		mask |= (uint32_t)(group[i] == value) << i;
+	}
+	return mask;
+#endif
+}
+
+// bit i set for every empty or deleted byte, both have the sign bit set
+inline uint32_t MatchFree(const int8_t* group) {
+#ifdef RUNTIME_SSE2
+	return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group)));
+#else
+	uint32_t mask = 0;
+	for (int i = 0; i < 16; ++i) {
+		mask |= (uint32_t)(group[i] < 0) << i;
+	}
+	return mask;
+#endif
+}
+
+inline int LowestBit(uint32_t mask) {
+	return std::countr_zero(mask);
+}
+
+inline int8_t H2(uint64_t hash) {
+	return (int8_t)(hash & 0x7F);
+}
+
+}
+
+RuntimeDict::~RuntimeDict() {
+	delete[] reinterpret_cast<uint8_t*>(this->ctrl);
+}
+
+bool RuntimeDict::Hash(RuntimeVar* key, uint64_t& hash) {
+	switch (key->GetType()->GetTypeEnum()) {
+	case ERuntimeType::Int64: {
+		// Fibonacci hashing spreads consecutive keys over both the probe start and the control bits
+		uint64_t x = (uint64_t)key->data.i64 * 0x9E3779B97F4A7C15ull;
+		hash = x ^ (x >> 32);
+		return true;
+	}
+	case ERuntimeType::String:
+		hash = RuntimeStringHash{}(std::string_view(key->data.str.ptr, key->data.str.size));
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool RuntimeDict::KeyEquals(RuntimeVar* a, RuntimeVar* b) {
+	ERuntimeType type = a->GetType()->GetTypeEnum();
+	if (type != b->GetType()->GetTypeEnum())
+		return false;
+	if (type == ERuntimeType::Int64)
+		return a->data.i64 == b->data.i64;
+	return a->data.str.size == b->data.str.size && !memcmp(a->data.str.ptr, b->data.str.ptr, a->data.str.size);
+}
+
+int64_t RuntimeDict::FindSlot(RuntimeVar* key, uint64_t hash) const {
+	if (!this->capacity)
+		return -1;
+	size_t groupMask = this->capacity / groupWidth - 1;
+	size_t group = (hash >> 7) & groupMask;
+	// triangular steps visit every group; the load limit leaves an empty slot somewhere, which ends the probe
+	for (size_t step = 1;; ++step) {
+		const int8_t* ctrlGroup = this->ctrl + group * groupWidth;
+		for (uint32_t match = MatchGroup(ctrlGroup, H2(hash)); match; match &= match - 1) {
+			size_t slot = group * groupWidth + LowestBit(match);
+			const Entry& entry = this->entries[this->slots[slot]];
+			if (entry.hash == hash && KeyEquals(entry.key, key))
+				return slot;
+		}
+		if (MatchGroup(ctrlGroup, ctrlEmpty))
+			return -1;
+		group = (group + step) & groupMask;
+	}
+}
+
+int64_t RuntimeDict::Find(RuntimeVar* key, uint64_t hash) const {
+	int64_t slot = this->FindSlot(key, hash);
+	return slot < 0 ? -1 : (int64_t)this->slots[slot];
+}
+
+size_t RuntimeDict::SlotOfEntry(size_t idx) const {
+	uint64_t hash = this->entries[idx].hash;
+	size_t groupMask = this->capacity / groupWidth - 1;
+	size_t group = (hash >> 7) & groupMask;
+	for (size_t step = 1;; ++step) {
+		for (uint32_t match = MatchGroup(this->ctrl + group * groupWidth, H2(hash)); match; match &= match - 1) {
+			size_t slot = group * groupWidth + LowestBit(match);
+			if (this->slots[slot] == idx)
+				return slot;
+		}
+		group = (group + step) & groupMask;
+	}
+}
+
+size_t RuntimeDict::FindFreeSlot(uint64_t hash) const {
+	size_t groupMask = this->capacity / groupWidth - 1;
+	size_t group = (hash >> 7) & groupMask;
+	for (size_t step = 1;; ++step) {
+		if (uint32_t free = MatchFree(this->ctrl + group * groupWidth))
+			return group * groupWidth + LowestBit(free);
+		group = (group + step) & groupMask;
+	}
+}
+
+void RuntimeDict::Insert(const Entry& entry) {
+	if (!this->growthLeft) {
+		// tombstones alone are cleaned up in place, a dict that is really full doubles
+		this->Resize(this->size + 1 > MaxEntries(this->capacity) / 2 ? std::max(this->capacity * 2, groupWidth) : this->capacity);
+	}
+	size_t slot = this->FindFreeSlot(entry.hash);
+	if (this->ctrl[slot] == ctrlEmpty)
+		this->growthLeft -= 1;
+	this->ctrl[slot] = H2(entry.hash);
+	this->slots[slot] = (uint32_t)this->size;
+	this->entries[this->size++] = entry;
+}
+
+bool RuntimeDict::Remove(RuntimeVar* key, uint64_t hash, Entry& removed) {
+	int64_t slot = this->FindSlot(key, hash);
+	if (slot < 0)
+		return false;
+	size_t idx = this->slots[slot];
+	removed = this->entries[idx];
+
+	// a group that still has an empty slot never sent a probe on to the next one, so the slot can become empty again
+	const int8_t* group = this->ctrl + (slot & ~(groupWidth - 1));
+	if (MatchGroup(group, ctrlEmpty)) {
+		this->ctrl[slot] = ctrlEmpty;
+		this->growthLeft += 1;
+	}
+	else {
+		this->ctrl[slot] = ctrlDeleted;
+	}
+
+	size_t last = this->size - 1;
+	if (idx != last) {
+		this->slots[this->SlotOfEntry(last)] = (uint32_t)idx;
+		this->entries[idx] = this->entries[last];
+	}
+	this->size -= 1;
+	return true;
+}
+
+void RuntimeDict::Reserve(size_t count) {
+	if (count <= MaxEntries(this->capacity))
+		return;
+	size_t newCapacity = std::max(this->capacity, groupWidth);
+	while (MaxEntries(newCapacity) < count) {
+		newCapacity *= 2;
+	}
+	this->Resize(newCapacity);
+}
+
+void RuntimeDict::Resize(size_t newCapacity) {
+	int8_t* oldCtrl = this->ctrl;
+	uint8_t* block = new uint8_t[BlockBytes(newCapacity)];
+	this->ctrl = reinterpret_cast<int8_t*>(block);
+	this->slots = reinterpret_cast<uint32_t*>(block + newCapacity);
+	Entry* newEntries = reinterpret_cast<Entry*>(block + newCapacity * (sizeof(int8_t) + sizeof(uint32_t)));
+	std::fill_n(this->ctrl, newCapacity, ctrlEmpty);
+	std::copy_n(this->entries, this->size, newEntries);
+	this->entries = newEntries;
+	this->capacity = newCapacity;
+	this->growthLeft = MaxEntries(newCapacity) - this->size;
+
+	// entries keep their order and their cached hashes, only the slots are rebuilt
+	for (size_t i = 0; i < this->size; ++i) {
+		size_t slot = this->FindFreeSlot(this->entries[i].hash);
+		this->ctrl[slot] = H2(this->entries[i].hash);
+		this->slots[slot] = (uint32_t)i;
+	}
+	delete[] reinterpret_cast<uint8_t*>(oldCtrl);
+}
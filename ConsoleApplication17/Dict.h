@@ -0,0 +1,64 @@
+#pragma once
+#include "Runtime.h"
+
+// Hash table held by Dict vars, Swiss table style: one control byte per slot (empty, deleted or the low 7 bits of
+// the key hash) probed 16 at a time, so a lookup compares keys only for slots whose bits already match. Slots hold
+// indices into a dense entry array, which keeps for-in and positional access O(1) and lets a resize reinsert from
+// the cached hashes without rehashing any string. Removal moves the last entry into the hole.
+// Keys and values are vars owned by the dict; keys are Int64 or String.
+class RuntimeDict {
+public:
+	struct Entry {
+		uint64_t hash;
+		RuntimeVar* key;
+		RuntimeVar* value;
+	};
+
+	RuntimeDict() : ctrl(nullptr), slots(nullptr), entries(nullptr), capacity(0), size(0), growthLeft(0) {}
+	RuntimeDict(const RuntimeDict&) = delete;
+	RuntimeDict& operator=(const RuntimeDict&) = delete;
+	~RuntimeDict();
+
+	// false for key types a dict can not hold
+	static bool Hash(RuntimeVar* key, uint64_t& hash);
+
+	// entry index of key, -1 when it is absent
+	int64_t Find(RuntimeVar* key, uint64_t hash) const;
+	// appends an entry whose key is not in the dict yet
+	void Insert(const Entry& entry);
+	// drops key and hands its entry back, false when it is absent
+	bool Remove(RuntimeVar* key, uint64_t hash, Entry& removed);
+	// room for count entries without another resize
+	void Reserve(size_t count);
+
+	size_t Size() const { return this->size; }
+	Entry& At(size_t idx) { return this->entries[idx]; }
+	const Entry& At(size_t idx) const { return this->entries[idx]; }
+	// heap bytes, the dict itself included, for MemoryUsage
+	size_t GetBytes() const { return sizeof(RuntimeDict) + BlockBytes(this->capacity); }
+
+private:
+	static constexpr size_t groupWidth = 16;
+	static constexpr int8_t ctrlEmpty = -128;
+	static constexpr int8_t ctrlDeleted = -2;
+
+	// one allocation: capacity control bytes, capacity slots, MaxEntries(capacity) entries
+	int8_t* ctrl;
+	uint32_t* slots;
+	Entry* entries;
+	size_t capacity; // 0 or a power of two, at least groupWidth
+	size_t size;
+	size_t growthLeft; // empty slots that may still be filled before the 7/8 load limit
+
+	static size_t MaxEntries(size_t capacity) { return capacity - capacity / 8; }
+	static size_t BlockBytes(size_t capacity) { return capacity * (sizeof(int8_t) + sizeof(uint32_t)) + MaxEntries(capacity) * sizeof(Entry); }
+	static bool KeyEquals(RuntimeVar* a, RuntimeVar* b);
+
+	// slot holding key, -1 when it is absent
+	int64_t FindSlot(RuntimeVar* key, uint64_t hash) const;
+	// slot holding entry idx
+	size_t SlotOfEntry(size_t idx) const;
+	// first empty or deleted slot on the probe sequence of hash
+	size_t FindFreeSlot(uint64_t hash) const;
+	void Resize(size_t newCapacity);
+};
@@ -0,0 +1,155 @@
+#include "GC.h"
+#include "Dict.h"
+#include "Heap.h"
+#include "Deque.h"
+#include "SortedMap.h"
+#include <chrono>
+
+size_t GarbageCollector::Step(RuntimeCtx* ctx) {
+	auto start = std::chrono::steady_clock::now();
+	this->Advance(ctx, this->policy.mode == EGcMode::Incremental ? this->policy.stepBudget : SIZE_MAX);
+
+	double pause = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	this->stats.pauses += 1;
+	this->stats.totalPauseUs += pause;
+	this->stats.maxPauseUs = std::max(this->stats.maxPauseUs, pause);
+	return this->GetTrigger();
+}
+
+void GarbageCollector::Collect(RuntimeCtx* ctx) {
+	if (this->phase != EPhase::Idle)
+		this->Advance(ctx, SIZE_MAX);
+	this->Advance(ctx, SIZE_MAX);
+}
+
+void GarbageCollector::ReleaseAll(RuntimeCtx* ctx) {
+	VarPool& pool = this->exec->varPool;
+	this->gray.clear();
+	pool.BeginCollection();
+	size_t freed = 0;
+	pool.Sweep(ctx, SIZE_MAX, freed);
+	this->exec->liveVars -= freed;
+	pool.EndCollection();
+	this->phase = EPhase::Idle;
+}
+
+size_t GarbageCollector::GetTrigger() const {
+	if (this->phase != EPhase::Idle)
+		return 0; // every safepoint until the cycle is done
+	if (this->policy.mode == EGcMode::Off)
+		return SIZE_MAX;
+	return std::max(this->policy.minHeap, (size_t)(this->exec->liveVars * this->policy.growth));
+}
+
+void GarbageCollector::Advance(RuntimeCtx* ctx, size_t budget) {
+	VarPool& pool = this->exec->varPool;
+	if (this->phase == EPhase::Idle) {
+		pool.BeginCollection();
+		this->cycleFreed = 0;
+		this->MarkRoots(ctx);
+		this->phase = EPhase::Mark;
+	}
+	if (this->phase == EPhase::Mark) {
+		if (!this->Drain(budget))
+			return;
+		// locals changed since the cycle started; whatever they point to now is marked already or reachable from here
+		this->MarkRoots(ctx);
+		size_t rest = SIZE_MAX;
+		this->Drain(rest);
+		this->phase = EPhase::Sweep;
+	}
+
+	size_t freed = 0;
+	bool done = pool.Sweep(ctx, budget, freed);
+	this->exec->liveVars -= freed;
+	this->cycleFreed += freed;
+	if (!done)
+		return;
+
+	pool.EndCollection();
+	this->phase = EPhase::Idle;
+	this->stats.collections += 1;
+	this->stats.freedVars += this->cycleFreed;
+}
+
+void GarbageCollector::MarkRoots(RuntimeCtx* ctx) {
+	auto markScope = [this](LocalScope* scope) {
+		for (auto& [name, state] : scope->locals) {
+			if (state.var) // natives return null on error
+				this->Shade(state.var);
+		}
+		for (auto& [name, state] : scope->parentLocals) {
+			if (state.var)
+				this->Shade(state.var);
+		}
+	};
+	for (LocalScope* scope : this->exec->scopeStack) {
+		markScope(scope);
+	}
+	if (this->exec->currentScope)
+		markScope(this->exec->currentScope);
+	for (RuntimeVar* var : this->exec->pinned) {
+		this->Shade(var);
+	}
+	// frame slots are not pool vars and have nothing to mark, only their elements do
+	for (RuntimeVar& var : this->exec->region.GetLive()) {
+		this->ShadeElements(&var);
+	}
+	for (auto& [hash, method] : ctx->GetMethods()) {
+		for (auto& [key, var] : method->GetMemoCache()) {
+			this->Shade(var);
+		}
+	}
+}
+
+void GarbageCollector::Shade(RuntimeVar* var) {
+	if (this->exec->varPool.Mark(var))
+		this->gray.push_back(var);
+}
+
+bool GarbageCollector::Drain(size_t& budget) {
+	while (!this->gray.empty()) {
+		if (budget == 0)
+			return false;
+		budget -= 1;
+		RuntimeVar* var = this->gray.back();
+		this->gray.pop_back();
+		this->ShadeElements(var);
+	}
+	return true;
+}
+
+void GarbageCollector::ShadeElements(RuntimeVar* var) {
+	ERuntimeType type = var->GetType()->GetTypeEnum();
+	if (type == ERuntimeType::Array) {
+		for (uint32_t i = 0; i < var->data.arr.size; ++i) {
+			this->Shade(var->data.arr.data[i]);
+		}
+	}
+	else if (type == ERuntimeType::Dict) {
+		const RuntimeDict* dict = static_cast<RuntimeDict*>(var->data.custom.dataBlob);
+		for (size_t i = 0; i < dict->Size(); ++i) {
+			this->Shade(dict->At(i).key);
+			this->Shade(dict->At(i).value);
+		}
+	}
+	else if (type == ERuntimeType::Heap) {
+		// a keyed heap's keys are elements of its values
+		const RuntimeHeap* heap = static_cast<RuntimeHeap*>(var->data.custom.dataBlob);
+		for (size_t i = 0; i < heap->Size(); ++i) {
+			this->Shade(heap->At(i).value);
+		}
+	}
+	else if (type == ERuntimeType::Deque) {
+		const RuntimeDeque* deque = static_cast<RuntimeDeque*>(var->data.custom.dataBlob);
+		for (size_t i = 0; i < deque->Size(); ++i) {
+			this->Shade(deque->At(i));
+		}
+	}
+	else if (type == ERuntimeType::SortedMap) {
+		static_cast<RuntimeSortedMap*>(var->data.custom.dataBlob)->ForEach([this](RuntimeVar* key, RuntimeVar* value) {
+			this->Shade(key);
+			this->Shade(value);
+		});
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "Runtime.h"
+
+enum class EGcMode {
+	Off,
+	Full, // a whole cycle in one pause
+	Incremental, // stepBudget vars of marking or sweeping per safepoint
+};
+
+struct GcPolicy {
+	EGcMode mode = EGcMode::Full;
+	size_t minHeap = 64 * 1024; // live vars before the first collection
+	double growth = 2.0; // the next cycle starts once live vars reach growth * the survivors of this one
+	size_t stepBudget = 4096;
+};
+
+struct GcStats {
+	uint64_t collections = 0;
+	uint64_t freedVars = 0;
+	uint64_t pauses = 0; // safepoints that did collection work
+	double totalPauseUs = 0;
+	double maxPauseUs = 0;
+};
+
+// Mark-sweep collector over the VarPool of one executor. Roots are the locals of every active scope, the frame slots
+// in its VarRegion, vars pinned by the executor (arguments of the outermost call, folded constants) and memo caches.
+// It only runs at safepoints between instructions, where every live var is reachable from a root.
+// Incremental cycles interleave with the script: vars allocated mid-cycle are born marked and the roots are scanned
+// again before sweeping. Script stores never move an existing var into a container (elements are fresh copies),
+// so no other write barrier is needed.
+class GarbageCollector {
+public:
+	explicit GarbageCollector(RuntimeExecutor* exec_) : exec(exec_), phase(EPhase::Idle), cycleFreed(0) {}
+
+	// the collection work due at a safepoint; returns the live var count at which the executor calls again
+	size_t Step(RuntimeCtx* ctx);
+	// runs a whole cycle now, finishing the current one first if it is incremental
+	void Collect(RuntimeCtx* ctx);
+	// abandons the current cycle and sweeps without roots
+	void ReleaseAll(RuntimeCtx* ctx);
+
+	void SetPolicy(const GcPolicy& policy_) { this->policy = policy_; }
+	const GcPolicy& GetPolicy() const { return this->policy; }
+	const GcStats& GetStats() const { return this->stats; }
+	size_t GetTrigger() const;
+
+private:
+	enum class EPhase { Idle, Mark, Sweep };
+
+	RuntimeExecutor* exec;
+	GcPolicy policy;
+	GcStats stats;
+	EPhase phase;
+	std::vector<RuntimeVar*> gray;
+	size_t cycleFreed;
+
+	void Advance(RuntimeCtx* ctx, size_t budget);
+	void MarkRoots(RuntimeCtx* ctx);
+	void Shade(RuntimeVar* var);
+	void ShadeElements(RuntimeVar* var);
+	// scans gray vars until the budget runs out, true once none are left
+	bool Drain(size_t& budget);
+};
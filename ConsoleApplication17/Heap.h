@@ -0,0 +1,91 @@
+#pragma once
+#include "Runtime.h"
+#include <algorithm>
+
+// Min-heap held by Heap vars. Four children per node: sift-down compares a node's children side by side in one
+// cache line of items and the tree is half as deep as a binary heap, so push and pop touch fewer levels.
+// Values are vars owned by the heap. A keyed heap orders [priority, payload] arrays by their first element; key
+// points into the value, or is the value itself otherwise. The ordering is passed in as less(a, b) over keys, so a
+// comparison that fails may leave the order broken but never the storage.
+class RuntimeHeap {
+public:
+	static constexpr size_t arity = 4;
+
+	struct Item {
+		RuntimeVar* key;
+		RuntimeVar* value;
+	};
+
+	explicit RuntimeHeap(bool keyed_) : keyed(keyed_) {}
+
+	bool IsKeyed() const { return this->keyed; }
+	size_t Size() const { return this->items.size(); }
+	// the smallest item, heap not empty
+	const Item& Top() const { return this->items.front(); }
+	// items in heap order, for copies and the GC
+	const Item& At(size_t idx) const { return this->items[idx]; }
+
+	template<typename Less>
+	void Push(const Item& item, Less less) {
+		this->items.push_back(item);
+		this->SiftUp(this->items.size() - 1, less);
+	}
+
+	// removes and returns the smallest item, heap not empty
+	template<typename Less>
+	Item Pop(Less less) {
+		Item top = this->items.front();
+		this->items.front() = this->items.back();
+		this->items.pop_back();
+		if (!this->items.empty())
+			this->SiftDown(0, less);
+		return top;
+	}
+
+	// appends an item that keeps the heap order, for copies
+	void Append(const Item& item) { this->items.push_back(item); }
+	void Reserve(size_t count) { this->items.reserve(count); }
+
+	// heap bytes, the heap itself included, for MemoryUsage
+	size_t GetBytes() const { return sizeof(RuntimeHeap) + this->items.capacity() * sizeof(Item); }
+
+private:
+	bool keyed;
+	std::vector<Item> items;
+
+	// moves the item at idx up past its larger parents, shifting them down instead of swapping
+	template<typename Less>
+	void SiftUp(size_t idx, Less less) {
+		Item item = this->items[idx];
+		while (idx > 0) {
+			size_t parent = (idx - 1) / arity;
+			if (!less(item.key, this->items[parent].key))
+				break;
+			this->items[idx] = this->items[parent];
+			idx = parent;
+		}
+		this->items[idx] = item;
+	}
+
+	template<typename Less>
+	void SiftDown(size_t idx, Less less) {
+		Item item = this->items[idx];
+		size_t size = this->items.size();
+		for (;;) {
+			size_t first = idx * arity + 1;
+			if (first >= size)
+				break;
+			size_t last = std::min(first + arity, size);
+			size_t best = first;
+			for (size_t child = first + 1; child < last; ++child) {
+				if (less(this->items[child].key, this->items[best].key))
+					best = child;
+			}
+			if (!less(this->items[best].key, item.key))
+				break;
+			this->items[idx] = this->items[best];
+			idx = best;
+		}
+		this->items[idx] = item;
+	}
+};
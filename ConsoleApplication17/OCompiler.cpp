@@ -77,7 +77,7 @@ vector<LexemeSyntax> Compiler::GetLexems(string inputFile) {
 			result.push_back(LexemeSyntax(ELexemeType::RoundBrack, rd, currentLine, stream.get_cur() - lineStartPos));
 			continue;
 		}
-		else if (rd == ',' || rd == ';') {
+		else if (rd == ',' || rd == ';' || rd == ':') {
 			stream.seek(1);
 			result.push_back(LexemeSyntax(ELexemeType::Punctuation, rd, currentLine, stream.get_cur() - lineStartPos));
 			continue;
@@ -200,6 +200,15 @@ CompilationResult* Compiler::Compile(string inputFile) {
 	std::cout << result->GetString() << std::endl;
 
 	this->runtime = new RuntimeCtx();
+	this->runtime->SetOptLevel(this->optLevel);
+	this->runtime->SetAutoMemo(this->autoMemo);
+	this->runtime->SetDisabledPasses(this->disabledPasses);
+	GcPolicy gcPolicy;
+	gcPolicy.mode = this->gcMode;
+	this->runtime->GetExecutor()->SetGcPolicy(gcPolicy);
+	ExecutorLimits limits;
+	limits.bytes = this->memoryLimit;
+	this->runtime->GetExecutor()->SetLimits(limits);
 	this->runtime->AddPoliz(this->parser, &this->parser->poliz);
 
 	int64_t ret = this->runtime->ExecuteRoot("main");
@@ -207,6 +216,17 @@ CompilationResult* Compiler::Compile(string inputFile) {
 	if (ret != 0) {
 		printf("[Script] Execution failed: %s\n", this->runtime->GetErrorString().c_str());
 	}
+	for (auto& [h, method] : this->runtime->GetMethods()) {
+		if (method->IsMemoized())
+			printf("Memo %s: %llu hits, %llu misses\n", method->GetName().c_str(), (unsigned long long)method->GetMemoHits(), (unsigned long long)method->GetMemoMisses());
+	}
+	const GcStats& gc = this->runtime->GetExecutor()->GetGcStats();
+	if (gc.collections) {
+		printf("GC: %llu collections, %llu vars freed, %llu pauses, max %.1f us, total %.1f us\n", (unsigned long long)gc.collections,
+			(unsigned long long)gc.freedVars, (unsigned long long)gc.pauses, gc.maxPauseUs, gc.totalPauseUs);
+	}
+	if (this->memoryLimit)
+		printf("Memory: peak %zu of %zu bytes\n", this->runtime->GetExecutor()->GetMemoryUsage().peakBytes, this->memoryLimit);
 
 
 	return result;
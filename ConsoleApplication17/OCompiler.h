@@ -2,7 +2,10 @@
 #include "Stream.h"
 #include "Lexeme.h"
 #include <sstream>
+#include <climits>
 #include "Parser.h"
+#include "Runtime.h"
+#include "GC.h"
 
 class CompileException : std::exception {
 public:
@@ -59,18 +62,35 @@ class Compiler
 	Stream stream;
 	Parser* parser;
 	RuntimeCtx* runtime;
+	EOptLevel optLevel;
+	bool autoMemo;
+	EGcMode gcMode;
+	size_t memoryLimit;
+	std::set<std::string> disabledPasses;
 public:
 	vector<LexemeSyntax> GetLexems(string inputFile);
 
 	Compiler() {
 		this->parser = nullptr;
 		this->runtime = nullptr;
+		this->optLevel = EOptLevel::O2;
+		this->autoMemo = false;
+		this->gcMode = EGcMode::Full;
+		this->memoryLimit = 0;
 	}
 	~Compiler() {
 		if (this->parser) delete this->parser;
 		this->parser = nullptr;
+		if (this->runtime) delete this->runtime;
+		this->runtime = nullptr;
 	}
 
+	void SetOptLevel(EOptLevel level) { this->optLevel = level; }
+	void SetAutoMemo(bool enable) { this->autoMemo = enable; }
+	void SetGcMode(EGcMode mode) { this->gcMode = mode; }
+	// bytes the script may hold at once, 0 for no limit
+	void SetMemoryLimit(size_t bytes) { this->memoryLimit = bytes; }
+	void DisablePass(const std::string& name) { this->disabledPasses.insert(name); }
 	CompilationResult* Compile(string inputFile);
 };
 
@@ -0,0 +1,797 @@
+#include "Optimizer.h"
+#include "SSA.h"
+
+int64_t Optimizer::GetJumpTarget(const std::vector<RuntimeInstr>& code, int64_t idx) {
+	return idx + 1 + code[idx].GetParam<int64_t>(0);
+}
+
+int64_t Optimizer::FindTempDefinition(const RuntimeInstr* code, int64_t idx, const std::string& name) {
+	// temporaries are defined once per method, so the nearest definition above is the only one
+	if (name.empty() || name[0] != '$')
+		return -1;
+	for (int64_t i = idx - 1; i >= 0; --i) {
+		auto defs = code[i].GetDefinedVars();
+		if (std::find(defs.begin(), defs.end(), name) != defs.end())
+			return i;
+	}
+	return -1;
+}
+
+bool Optimizer::IsIntConst(const std::vector<RuntimeInstr>& code, int64_t idx, const std::string& name, int64_t& value) {
+	int64_t def = FindTempDefinition(code.data(), idx, name);
+	if (def < 0 || code[def].opcode != RuntimeInstrType::Ctor || code[def].GetParam<TID>(1) != Hash{}("Int64"))
+		return false;
+	value = code[def].GetParam<int64_t>(2);
+	return true;
+}
+
+void Optimizer::EliminateBoundsChecks(RuntimeCtx* ctx, std::vector<RuntimeInstr>& code) {
+	const int64_t size = code.size();
+	std::set<int64_t> jumpTargets;
+	for (int64_t i = 0; i < size; ++i) {
+		if (!code[i].IsJump())
+			continue;
+		for (int64_t delta : code[i].GetJumpDeltas()) {
+			jumpTargets.insert(i + 1 + delta);
+		}
+	}
+
+	for (int64_t e = 0; e < size; ++e) {
+		if (code[e].opcode != RuntimeInstrType::Jmp)
+			continue;
+		int64_t h = GetJumpTarget(code, e);
+		if (h > e || h + 1 >= e)
+			continue;
+
+		// header: bound = len(array) / ArraySize(array), then exit unless itr < bound
+		const RuntimeInstr& head = code[h];
+		std::string array, bound, itr;
+		if (head.opcode == RuntimeInstrType::UnOperation && head.GetParam<ERuntimeCallType>(1) == ERuntimeCallType::ArraySize) {
+			bound = head.GetParam<std::string>(0);
+			array = head.GetParam<std::string>(2);
+		}
+		else if (head.opcode == RuntimeInstrType::Len) {
+			bound = head.GetParam<std::string>(0);
+			array = head.GetParam<std::string>(1);
+		}
+		else {
+			continue;
+		}
+
+		int64_t exitJump = -1;
+		const RuntimeInstr& cond = code[h + 1];
+		if (cond.opcode == RuntimeInstrType::Jge && cond.GetParam<std::string>(1) == bound) {
+			itr = cond.GetParam<std::string>(2);
+			exitJump = h + 1;
+		}
+		else if (cond.opcode == RuntimeInstrType::Operation && code[h + 2].opcode == RuntimeInstrType::Jz && code[h + 2].GetParam<std::string>(1) == cond.GetParam<std::string>(0)) {
+			ERuntimeCallType op = cond.GetParam<ERuntimeCallType>(1);
+			if (op == ERuntimeCallType::CompareLess && cond.GetParam<std::string>(3) == bound)
+				itr = cond.GetParam<std::string>(2);
+			else if (op == ERuntimeCallType::CompareGreater && cond.GetParam<std::string>(2) == bound)
+				itr = cond.GetParam<std::string>(3);
+			exitJump = h + 2;
+		}
+		if (itr.empty() || itr == array || itr == bound || GetJumpTarget(code, exitJump) != e + 1)
+			continue;
+
+		// the array is never reassigned in the loop (builtins can only grow it) and itr has a single definition
+		bool ok = true;
+		int64_t step = -1;
+		for (int64_t k = h; k <= e && ok; ++k) {
+			for (auto& def : code[k].GetDefinedVars()) {
+				if (def == array)
+					ok = false;
+				else if (def == itr) {
+					if (step >= 0)
+						ok = false;
+					step = k;
+				}
+			}
+		}
+		if (!ok || step <= exitJump + 1)
+			continue;
+
+		// itr = itr + c, c >= 0
+		const RuntimeInstr& assign = code[step];
+		const RuntimeInstr& add = code[step - 1];
+		if (assign.opcode != RuntimeInstrType::Operation || assign.GetParam<ERuntimeCallType>(1) != ERuntimeCallType::Assign)
+			continue;
+		if (add.opcode != RuntimeInstrType::Operation || add.GetParam<ERuntimeCallType>(1) != ERuntimeCallType::Add || add.GetParam<std::string>(0) != assign.GetParam<std::string>(3))
+			continue;
+		std::string increment;
+		if (add.GetParam<std::string>(2) == itr)
+			increment = add.GetParam<std::string>(3);
+		else if (add.GetParam<std::string>(3) == itr)
+			increment = add.GetParam<std::string>(2);
+		int64_t value = 0;
+		if (increment.empty() || !IsIntConst(code, step - 1, increment, value) || value < 0)
+			continue;
+
+		// the increment runs exactly once per iteration: it is not skipped by a branch or repeated by an inner loop
+		for (int64_t k = exitJump + 1; k < e && ok; ++k) {
+			if (!code[k].IsJump())
+				continue;
+			int64_t t = GetJumpTarget(code, k);
+			if ((k < step && t > step) || (t <= step && k >= step))
+				ok = false;
+		}
+		if (!ok)
+			continue;
+
+		// itr = c, c >= 0 on every entry: the header is only reached from the loop itself or by falling through
+		for (int64_t k = 0; k < size && ok; ++k) {
+			if (code[k].IsJump() && GetJumpTarget(code, k) == h && (k < h || k > e))
+				ok = false;
+		}
+		bool initialized = false;
+		for (int64_t k = h - 1; k >= 0 && ok; --k) {
+			if (code[k].IsJump())
+				break;
+			auto defs = code[k].GetDefinedVars();
+			if (std::find(defs.begin(), defs.end(), itr) != defs.end()) {
+				initialized = code[k].opcode == RuntimeInstrType::Operation && code[k].GetParam<ERuntimeCallType>(1) == ERuntimeCallType::Assign &&
+					IsIntConst(code, k, code[k].GetParam<std::string>(3), value) && value >= 0;
+				break;
+			}
+			if (jumpTargets.count(k))
+				break;
+		}
+		if (!ok || !initialized)
+			continue;
+
+		// 0 <= itr < len(array) holds from the header check until the increment
+		for (int64_t k = exitJump + 1; k < step; ++k) {
+			RuntimeInstr& instr = code[k];
+			if (instr.opcode != RuntimeInstrType::Operation || instr.GetParam<ERuntimeCallType>(1) != ERuntimeCallType::ArrayAccess)
+				continue;
+			if (instr.GetParam<std::string>(2) != array || instr.GetParam<std::string>(3) != itr)
+				continue;
+			RuntimeInstr access(RuntimeInstrType::ArrayAccess);
+			access.AddParam(instr.GetParam<std::string>(0));
+			access.AddParam(array);
+			access.AddParam(itr);
+			instr = access;
+		}
+	}
+}
+
+bool Optimizer::MayMutateArgs(RuntimeCtx* ctx, const RuntimeInstr& instr) {
+	if (instr.opcode == RuntimeInstrType::Append)
+		return true;
+	if (instr.opcode != RuntimeInstrType::Call)
+		return false;
+	// script methods get copies of their params, natives see the caller's vars
+	RuntimeMethod* method = ctx->GetMethod(instr.GetParam<std::string>(1));
+	return method && method->IsNative() && method->WritesArgs();
+}
+
+bool Optimizer::IsHoistable(const RuntimeInstr& instr) {
+	switch (instr.opcode) {
+	case RuntimeInstrType::Ctor:
+	case RuntimeInstrType::UnOperation:
+	case RuntimeInstrType::Len:
+	case RuntimeInstrType::ToInt:
+		return true;
+	case RuntimeInstrType::Operation: {
+		// ArrayAccess results alias array elements, Assign writes its target
+		ERuntimeCallType op = instr.GetParam<ERuntimeCallType>(1);
+		return op != ERuntimeCallType::Assign && op != ERuntimeCallType::ArrayAccess && op != ERuntimeCallType::ArrayAppend;
+	}
+	default:
+		return false;
+	}
+}
+
+void Optimizer::HoistLoop(RuntimeCtx* ctx, ControlFlowGraph& cfg, const Loop& loop) {
+	// vars the loop may write: definitions, natives that take them and element aliases; arrays indexed in
+	// the loop may have their elements written through an alias but keep their size
+	std::map<std::string, int> defCount;
+	std::set<std::string> mutated, elementsWritten;
+	for (size_t id = 0; id < cfg.GetBlockCount(); ++id) {
+		bool inLoop = loop.blocks.count(id);
+		for (auto& instr : cfg.GetBlock(id).instrs) {
+			bool access = instr.opcode == RuntimeInstrType::ArrayAccess ||
+				(instr.opcode == RuntimeInstrType::Operation && instr.GetParam<ERuntimeCallType>(1) == ERuntimeCallType::ArrayAccess);
+			if (access)
+				mutated.insert(instr.GetParam<std::string>(0));
+			if (!inLoop)
+				continue;
+			for (auto& def : instr.GetDefinedVars()) {
+				defCount[def] += 1;
+			}
+			if (access)
+				elementsWritten.insert(instr.GetUsedVars()[0]);
+			if (MayMutateArgs(ctx, instr)) {
+				for (auto& arg : instr.GetUsedVars()) {
+					mutated.insert(arg);
+				}
+			}
+		}
+	}
+
+	// Work from the body may fail, so it only moves to a landing pad that runs once the header has let the first
+	// iteration through. That needs the header to exit on its jump and continue into the loop, and the block to run
+	// on every iteration before anything can leave the loop.
+	const BasicBlock& header = cfg.GetBlock(loop.header);
+	bool rotate = header.fallthrough >= 0 && loop.blocks.count(header.fallthrough) &&
+		header.jumpTarget >= 0 && !loop.blocks.count(header.jumpTarget);
+	// the preheader's copy of the header defines renamed temporaries, so the header's own may only be read there
+	std::set<std::string> headerTemps;
+	for (auto& instr : header.instrs) {
+		for (auto& def : instr.GetDefinedVars()) {
+			if (!def.empty() && def[0] == '$')
+				headerTemps.insert(def);
+		}
+	}
+	for (size_t id = 0; rotate && id < cfg.GetBlockCount(); ++id) {
+		if ((int)id == loop.header)
+			continue;
+		for (auto& instr : cfg.GetBlock(id).instrs) {
+			for (auto& used : instr.GetUsedVars()) {
+				if (headerTemps.count(used))
+					rotate = false;
+			}
+		}
+	}
+	std::vector<int> candidates = { loop.header };
+	for (int id : cfg.GetLayout()) {
+		if (!rotate || id == loop.header || !loop.blocks.count(id))
+			continue;
+		bool everyIteration = true;
+		for (int other : loop.blocks) {
+			bool exits = cfg.GetBlock(other).GetSuccessors().empty();
+			for (int succ : cfg.GetBlock(other).GetSuccessors()) {
+				exits = exits || !loop.blocks.count(succ);
+			}
+			bool latch = std::find(loop.latches.begin(), loop.latches.end(), other) != loop.latches.end();
+			if (other != loop.header && (exits || latch) && !cfg.Dominates(id, other))
+				everyIteration = false;
+		}
+		if (everyIteration)
+			candidates.push_back(id);
+	}
+
+	// temporaries have a single definition, so an invariant one holds the same value for the whole loop
+	std::set<std::string> invariant;
+	std::set<std::pair<int, size_t>> hoisted;
+	std::vector<RuntimeInstr> headerWork, bodyWork;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (int id : candidates) {
+			const auto& instrs = cfg.GetBlock(id).instrs;
+			for (size_t i = 0; i < instrs.size(); ++i) {
+				const RuntimeInstr& instr = instrs[i];
+				if (hoisted.count({ id, i }) || !IsHoistable(instr))
+					continue;
+				const std::string& def = instr.GetParam<std::string>(0);
+				if (def.empty() || def[0] != '$' || defCount[def] != 1 || mutated.count(def))
+					continue;
+				bool sizeOnly = instr.opcode == RuntimeInstrType::Len ||
+					(instr.opcode == RuntimeInstrType::UnOperation && instr.GetParam<ERuntimeCallType>(1) == ERuntimeCallType::ArraySize);
+				bool operandsInvariant = true;
+				for (auto& used : instr.GetUsedVars()) {
+					if (!invariant.count(used) && (defCount.count(used) || mutated.count(used) || (!sizeOnly && elementsWritten.count(used))))
+						operandsInvariant = false;
+				}
+				if (!operandsInvariant)
+					continue;
+				hoisted.insert({ id, i });
+				invariant.insert(def);
+				(id == loop.header ? headerWork : bodyWork).push_back(instr);
+				changed = true;
+			}
+		}
+	}
+	if (hoisted.empty())
+		return;
+
+	for (int id : candidates) {
+		auto& instrs = cfg.GetBlock(id).instrs;
+		std::vector<RuntimeInstr> kept;
+		for (size_t i = 0; i < instrs.size(); ++i) {
+			if (!hoisted.count({ id, i }))
+				kept.push_back(instrs[i]);
+		}
+		instrs = kept;
+	}
+
+	// preheader right before the header, so anything falling into the header now falls into it
+	size_t pos = cfg.GetLayoutPos(loop.header);
+	int pre = cfg.InsertBlock(pos);
+	int pad = -1;
+	cfg.GetBlock(pre).instrs = headerWork;
+	cfg.GetBlock(pre).fallthrough = loop.header;
+	if (!bodyWork.empty()) {
+		// rotate: the preheader evaluates a copy of the header, the pad then enters the body directly
+		pad = cfg.InsertBlock(pos + 1);
+		BasicBlock& preBlock = cfg.GetBlock(pre);
+		const BasicBlock& headerBlock = cfg.GetBlock(loop.header);
+		// temporaries keep a single definition: the copy gets its own, unique to this preheader
+		std::map<std::string, std::string> renamed;
+		for (auto& instr : headerBlock.instrs) {
+			for (auto& def : instr.GetDefinedVars()) {
+				if (headerTemps.count(def))
+					renamed[def] = def + "_" + std::to_string(pre);
+			}
+		}
+		for (RuntimeInstr instr : headerBlock.instrs) {
+			RenameTemps(instr, renamed);
+			preBlock.instrs.push_back(instr);
+		}
+		preBlock.jumpTarget = headerBlock.jumpTarget;
+		preBlock.fallthrough = pad;
+		cfg.GetBlock(pad).instrs = bodyWork;
+		cfg.GetBlock(pad).fallthrough = headerBlock.fallthrough;
+	}
+	for (size_t id = 0; id < cfg.GetBlockCount(); ++id) {
+		if (loop.blocks.count(id) || (int)id == pre || (int)id == pad)
+			continue;
+		BasicBlock& block = cfg.GetBlock(id);
+		if (block.fallthrough == loop.header)
+			block.fallthrough = pre;
+		if (block.jumpTarget == loop.header)
+			block.jumpTarget = pre;
+		std::replace(block.caseTargets.begin(), block.caseTargets.end(), loop.header, pre);
+	}
+	cfg.Analyze();
+}
+
+void Optimizer::RenameTemps(RuntimeInstr& instr, const std::map<std::string, std::string>& renamed) {
+	// only params naming locals: literals and method names are left alone
+	std::vector<size_t> params;
+	if (instr.opcode == RuntimeInstrType::RangeNext)
+		params = { 2, 3 };
+	else if (!instr.GetDefinedVars().empty())
+		params = { 0 };
+	auto [first, last] = instr.GetUsedParams();
+	for (size_t i = first; i < last; ++i) {
+		params.push_back(i);
+	}
+	for (size_t i : params) {
+		auto it = renamed.find(instr.GetParam<std::string>(i));
+		if (it != renamed.end())
+			instr.RefParam<std::string>(i) = it->second;
+	}
+}
+
+void Optimizer::HoistLoopInvariants(RuntimeCtx* ctx, ControlFlowGraph& cfg) {
+	// innermost first: an inner preheader lies in the outer loop, so its work can move out again
+	std::set<int> processed;
+	while (true) {
+		const Loop* next = nullptr;
+		for (auto& loop : cfg.GetLoops()) {
+			if (!processed.count(loop.header) && (!next || loop.blocks.size() < next->blocks.size()))
+				next = &loop;
+		}
+		if (!next)
+			break;
+		Loop loop = *next;
+		processed.insert(loop.header);
+		HoistLoop(ctx, cfg, loop);
+	}
+}
+
+bool Optimizer::GetValueKey(const RuntimeInstr& instr, std::map<std::string, int64_t>& numbers, int64_t& nextNumber, ValueKey& key) {
+	auto numberOf = [&](const std::string& name) {
+		auto it = numbers.find(name);
+		if (it == numbers.end())
+			it = numbers.emplace(name, nextNumber++).first;
+		return it->second;
+	};
+	if (instr.opcode == RuntimeInstrType::Ctor) {
+		// constants are numbered by type and encoded value
+		key = { instr.opcode, ERuntimeCallType::Invalid, { (int64_t)instr.GetParam<TID>(1) } };
+		for (size_t i = 2; i < instr.GetParamCount(); ++i) {
+			for (uint8_t byte : instr.GetRawParam(i)) {
+				std::get<2>(key).push_back(byte);
+			}
+		}
+		return true;
+	}
+	ERuntimeCallType op;
+	if (instr.opcode == RuntimeInstrType::ArrayAccess)
+		op = ERuntimeCallType::ArrayAccess; // same element as the checked form
+	else if (instr.opcode == RuntimeInstrType::Operation || instr.opcode == RuntimeInstrType::UnOperation)
+		op = instr.GetParam<ERuntimeCallType>(1);
+	else if (instr.opcode == RuntimeInstrType::Len || instr.opcode == RuntimeInstrType::ToInt)
+		op = ERuntimeCallType::Invalid;
+	else
+		return false;
+	if (op == ERuntimeCallType::Assign || op == ERuntimeCallType::ArrayAppend)
+		return false;
+
+	key = { instr.opcode == RuntimeInstrType::ArrayAccess ? RuntimeInstrType::Operation : instr.opcode, op, {} };
+	for (auto& used : instr.GetUsedVars()) {
+		std::get<2>(key).push_back(numberOf(used));
+	}
+	return true;
+}
+
+void Optimizer::NumberValues(RuntimeCtx* ctx, ControlFlowGraph& cfg) {
+	// temporaries used outside their block stay as they are
+	std::map<std::string, std::set<int>> useBlocks;
+	std::set<std::string> aliases;
+	for (size_t id = 0; id < cfg.GetBlockCount(); ++id) {
+		for (auto& instr : cfg.GetBlock(id).instrs) {
+			for (auto& used : instr.GetUsedVars()) {
+				useBlocks[used].insert(id);
+			}
+			ValueKey key;
+			std::map<std::string, int64_t> numbers;
+			int64_t nextNumber = 0;
+			if (GetValueKey(instr, numbers, nextNumber, key) && std::get<1>(key) == ERuntimeCallType::ArrayAccess)
+				aliases.insert(instr.GetParam<std::string>(0));
+		}
+	}
+
+	for (size_t id = 0; id < cfg.GetBlockCount(); ++id) {
+		auto& instrs = cfg.GetBlock(id).instrs;
+		std::map<std::string, int> defCount;
+		std::set<std::string> passedToNatives;
+		for (auto& instr : instrs) {
+			for (auto& def : instr.GetDefinedVars()) {
+				defCount[def] += 1;
+			}
+			if (MayMutateArgs(ctx, instr)) {
+				for (auto& arg : instr.GetUsedVars()) {
+					passedToNatives.insert(arg);
+				}
+			}
+		}
+
+		std::map<std::string, int64_t> numbers;
+		int64_t nextNumber = 0;
+		std::map<ValueKey, std::string> available;
+		std::map<std::string, std::string> replaced;
+		std::vector<RuntimeInstr> kept;
+		for (auto& original : instrs) {
+			RuntimeInstr instr = original;
+			auto [first, last] = instr.GetUsedParams();
+			for (size_t i = first; i < last; ++i) {
+				auto it = replaced.find(instr.GetParam<std::string>(i));
+				if (it != replaced.end())
+					instr.RefParam<std::string>(i) = it->second;
+			}
+
+			ValueKey key;
+			bool numbered = GetValueKey(instr, numbers, nextNumber, key);
+			if (numbered) {
+				const std::string& def = instr.GetParam<std::string>(0);
+				auto hit = available.find(key);
+				bool local = !def.empty() && def[0] == '$' && defCount[def] == 1 && !passedToNatives.count(def) &&
+					(!useBlocks.count(def) || useBlocks[def] == std::set<int>{ (int)id });
+				if (hit != available.end() && local) {
+					replaced[def] = hit->second;
+					numbers[def] = numbers[hit->second];
+					continue;
+				}
+			}
+
+			// writes through an element alias or by a native may change any array, drop everything read from memory
+			bool memoryWrite = MayMutateArgs(ctx, instr);
+			if (instr.opcode == RuntimeInstrType::Operation && instr.GetParam<ERuntimeCallType>(1) == ERuntimeCallType::Assign &&
+				aliases.count(instr.GetParam<std::string>(0)))
+				memoryWrite = true;
+			if (memoryWrite) {
+				available.clear();
+				for (auto& alias : aliases) {
+					numbers[alias] = nextNumber++;
+				}
+			}
+			for (auto& def : instr.GetDefinedVars()) {
+				numbers[def] = nextNumber++;
+			}
+
+			if (numbered) {
+				const std::string& def = instr.GetParam<std::string>(0);
+				bool operandChanged = false;
+				for (auto& used : instr.GetUsedVars()) {
+					operandChanged = operandChanged || used == def;
+				}
+				if (defCount[def] == 1 && !passedToNatives.count(def) && !operandChanged)
+					available[key] = def;
+			}
+			kept.push_back(instr);
+		}
+		instrs = kept;
+	}
+}
+
+void Optimizer::RemoveDeadStores(RuntimeCtx* ctx, ControlFlowGraph& cfg) {
+	std::set<std::string> aliases;
+	for (size_t id = 0; id < cfg.GetBlockCount(); ++id) {
+		for (auto& instr : cfg.GetBlock(id).instrs) {
+			if (instr.opcode == RuntimeInstrType::ArrayAccess ||
+				(instr.opcode == RuntimeInstrType::Operation && instr.GetParam<ERuntimeCallType>(1) == ERuntimeCallType::ArrayAccess))
+				aliases.insert(instr.GetParam<std::string>(0));
+		}
+	}
+
+	// removing an assignment can leave its source constant unused, go until nothing changes
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		SSAForm ssa(cfg);
+		for (int id : cfg.GetLayout()) {
+			if (!cfg.IsReachable(id))
+				continue;
+			auto& instrs = cfg.GetBlock(id).instrs;
+			std::vector<RuntimeInstr> kept;
+			for (size_t i = 0; i < instrs.size(); ++i) {
+				const RuntimeInstr& instr = instrs[i];
+				// constructors and copies can't fail; a copy into an element alias writes the array
+				bool removable = instr.opcode == RuntimeInstrType::Ctor ||
+					(instr.opcode == RuntimeInstrType::Operation && instr.GetParam<ERuntimeCallType>(1) == ERuntimeCallType::Assign &&
+						!aliases.count(instr.GetParam<std::string>(0)));
+				if (removable && ssa.GetUseCount(ssa.GetDefs(id, i)[0]) == 0) {
+					changed = true;
+					continue;
+				}
+				kept.push_back(instr);
+			}
+			instrs = kept;
+		}
+	}
+}
+
+bool Optimizer::WritesParams(RuntimeCtx* ctx, RuntimeMethod* method) {
+	// script methods get copies of their arguments, so this only matters for writes the caller could see if they
+	// were passed by reference; params and the elements borrowed from them count
+	const RuntimeInstr* code = ctx->GetInstr(method->GetVA());
+	const size_t size = method->GetCodeSize();
+	const auto& params = method->GetParamNames();
+	std::set<std::string> aliases(params.begin(), params.end());
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (size_t i = 0; i < size; ++i) {
+			const RuntimeInstr& instr = code[i];
+			bool access = instr.opcode == RuntimeInstrType::ArrayAccess ||
+				(instr.opcode == RuntimeInstrType::Operation && instr.GetParam<ERuntimeCallType>(1) == ERuntimeCallType::ArrayAccess);
+			if (access && aliases.count(instr.GetUsedVars()[0]) && aliases.insert(instr.GetParam<std::string>(0)).second)
+				changed = true;
+		}
+	}
+
+	for (size_t i = 0; i < size; ++i) {
+		const RuntimeInstr& instr = code[i];
+		if (instr.opcode == RuntimeInstrType::Operation && instr.GetParam<ERuntimeCallType>(1) == ERuntimeCallType::Assign) {
+			const std::string& target = instr.GetParam<std::string>(0);
+			if (aliases.count(target) && std::find(params.begin(), params.end(), target) == params.end())
+				return true;
+		}
+		if (MayMutateArgs(ctx, instr)) {
+			for (auto& arg : instr.GetUsedVars()) {
+				if (aliases.count(arg))
+					return true;
+			}
+		}
+	}
+	return false;
+}
+
+void Optimizer::AnalyzePurity(RuntimeCtx* ctx) {
+	std::vector<RuntimeMethod*> scripted;
+	for (auto& [h, method] : ctx->GetMethods()) {
+		if (method->IsNative())
+			continue;
+		method->SetPure(!WritesParams(ctx, method));
+		scripted.push_back(method);
+	}
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (RuntimeMethod* method : scripted) {
+			if (!method->IsPure())
+				continue;
+			const RuntimeInstr* code = ctx->GetInstr(method->GetVA());
+			for (size_t i = 0; i < method->GetCodeSize(); ++i) {
+				if (code[i].opcode != RuntimeInstrType::Call)
+					continue;
+				RuntimeMethod* callee = ctx->GetMethod(code[i].GetParam<std::string>(1));
+				if (!callee || !callee->IsPure()) {
+					method->SetPure(false);
+					changed = true;
+					break;
+				}
+			}
+		}
+	}
+}
+
+RuntimeVar* Optimizer::EvaluateConstant(RuntimeCtx* ctx, RuntimeExecutor& sandbox, const RuntimeInstr* code, int64_t idx, const std::string& name) {
+	int64_t def = FindTempDefinition(code, idx, name);
+	if (def < 0)
+		return nullptr;
+	const RuntimeInstr& instr = code[def];
+	if (instr.opcode == RuntimeInstrType::Ctor) {
+		RuntimeVar* var = sandbox.CreateVar(ctx);
+		var->ConstructFrom(ctx, instr);
+		return var;
+	}
+	if (instr.opcode == RuntimeInstrType::UnOperation) {
+		ERuntimeCallType callType = instr.GetParam<ERuntimeCallType>(1);
+		RuntimeVar* p1 = EvaluateConstant(ctx, sandbox, code, def, instr.GetParam<std::string>(2));
+		if (!p1)
+			return nullptr;
+		RuntimeVar* result = nullptr;
+		if (callType == ERuntimeCallType::UnNot) {
+			result = sandbox.CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
+			result->data.i64 = p1->IsFalse();
+		}
+		else if (p1->GetType()->HasOperator(callType)) {
+			result = p1->CallOperator(callType, ctx, &sandbox, nullptr);
+		}
+		sandbox.ReturnVar(ctx, p1);
+		return result;
+	}
+	if (instr.opcode != RuntimeInstrType::Operation)
+		return nullptr;
+	// the executor spells these out itself instead of calling the operator
+	ERuntimeCallType callType = instr.GetParam<ERuntimeCallType>(1);
+	switch (callType) {
+	case ERuntimeCallType::Assign:
+	case ERuntimeCallType::ArrayAccess:
+	case ERuntimeCallType::CompareNotEq:
+	case ERuntimeCallType::CompareLessEq:
+	case ERuntimeCallType::CompareGreater:
+	case ERuntimeCallType::CompareGreaterEq:
+		return nullptr;
+	default:
+		break;
+	}
+	RuntimeVar* p1 = EvaluateConstant(ctx, sandbox, code, def, instr.GetParam<std::string>(2));
+	if (!p1)
+		return nullptr;
+	RuntimeVar* p2 = EvaluateConstant(ctx, sandbox, code, def, instr.GetParam<std::string>(3));
+	if (!p2) {
+		sandbox.ReturnVar(ctx, p1);
+		return nullptr;
+	}
+	RuntimeVar* result = nullptr;
+	if (callType == ERuntimeCallType::Or || callType == ERuntimeCallType::And) {
+		result = sandbox.CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
+		if (callType == ERuntimeCallType::Or)
+			result->data.i64 = !p1->IsFalse() || !p2->IsFalse();
+		else
+			result->data.i64 = !p1->IsFalse() && !p2->IsFalse();
+	}
+	else if (p1->GetType()->HasOperator(callType)) {
+		result = p1->CallOperator(callType, ctx, &sandbox, p2);
+	}
+	sandbox.ReturnVar(ctx, p1);
+	sandbox.ReturnVar(ctx, p2);
+	return result;
+}
+
+bool Optimizer::EvaluateCall(RuntimeCtx* ctx, RuntimeMethod* method, const RuntimeInstr* code, int64_t idx, uint64_t& budget, RuntimeInstr& folded) {
+	// steps come out of the shared budget, depth stays off the native stack limit
+	RuntimeExecutor sandbox;
+	sandbox.SetLimits({ budget, 100000, 256, 64 * 1024 * 1024 });
+	sandbox.Reset();
+
+	const RuntimeInstr& call = code[idx];
+	const std::string& ret = call.GetParam<std::string>(0);
+	std::vector<RuntimeVar*> params;
+	for (size_t p = 2; p < call.GetParamCount(); ++p) {
+		RuntimeVar* var = EvaluateConstant(ctx, sandbox, code, idx, call.GetParam<std::string>(p));
+		if (!var)
+			break;
+		params.push_back(var);
+		if (sandbox.IsErrored())
+			break;
+	}
+	RuntimeVar* result = nullptr;
+	if (params.size() + 2 == call.GetParamCount() && !sandbox.IsErrored()) {
+		result = sandbox.CallMethod(ctx, method, params);
+		budget -= std::min(budget, sandbox.GetSteps());
+	}
+	bool ok = result && !sandbox.IsErrored();
+
+	folded = RuntimeInstr(RuntimeInstrType::Ctor);
+	folded.AddParam(ret);
+	switch (ok ? result->GetType()->GetTypeEnum() : ERuntimeType::Custom) {
+	case ERuntimeType::Null:
+		folded.AddParam<TID>(Hash{}("Null"));
+		break;
+	case ERuntimeType::Int64:
+		folded.AddParam<TID>(Hash{}("Int64"));
+		folded.AddParam<int64_t>(result->data.i64);
+		break;
+	case ERuntimeType::Double:
+		folded.AddParam<TID>(Hash{}("Double"));
+		folded.AddParam<double>(result->data.dbl);
+		break;
+	case ERuntimeType::String:
+		folded.AddParam<TID>(Hash{}("String"));
+		folded.AddParam(std::string(result->data.str.ptr, result->data.str.size));
+		break;
+	default: {
+		if (!ok || !result->GetType()->HasCopy()) {
+			ok = false;
+			break;
+		}
+		// containers: the sandbox goes away, the constant lives as long as the main executor
+		RuntimeVar* value = ctx->GetExecutor()->CreateVar(ctx);
+		value->CopyFrom(ctx, ctx->GetExecutor(), result);
+		ctx->GetExecutor()->PinVar(value);
+		folded = RuntimeInstr(RuntimeInstrType::Const);
+		folded.AddParam(ret);
+		folded.AddParam(value);
+		break;
+	}
+	}
+
+	// the result, the params and the elements of any array they built
+	sandbox.ReleaseScope(ctx);
+	sandbox.ReleaseVars(ctx);
+	return ok;
+}
+
+void Optimizer::FoldConstantCalls(RuntimeCtx* ctx) {
+	// enough for table builders, small enough to keep compilation fast however many calls fail to fold
+	uint64_t budget = 1000000;
+	for (auto& [h, method] : ctx->GetMethods()) {
+		if (method->IsNative())
+			continue;
+		RuntimeInstr* code = ctx->GetInstr(method->GetVA());
+		for (size_t i = 0; i < method->GetCodeSize() && budget; ++i) {
+			if (code[i].opcode != RuntimeInstrType::Call)
+				continue;
+			RuntimeMethod* callee = ctx->GetMethod(code[i].GetParam<std::string>(1));
+			if (!callee || callee->IsNative() || !callee->IsPure() || callee->IsMemoRequested() || ctx->IsAutoMemo())
+				continue;
+			RuntimeInstr folded;
+			if (!EvaluateCall(ctx, callee, code, i, budget, folded))
+				continue;
+			// one instruction for another, jumps stay valid
+			code[i] = folded;
+		}
+	}
+}
+
+void Optimizer::AllocateFrameSlots(RuntimeCtx* ctx) {
+	for (auto& [h, method] : ctx->GetMethods()) {
+		if (method->IsNative())
+			continue;
+		RuntimeInstr* code = ctx->GetInstr(method->GetVA());
+		const size_t size = method->GetCodeSize();
+
+		// a temporary bound to an array element aliases a var of the array, which may outlive the call
+		std::set<std::string> escaping;
+		for (size_t i = 0; i < size; ++i) {
+			const RuntimeInstr& instr = code[i];
+			if (instr.opcode == RuntimeInstrType::ArrayAccess ||
+				(instr.opcode == RuntimeInstrType::Operation && instr.GetParam<ERuntimeCallType>(1) == ERuntimeCallType::ArrayAccess))
+				escaping.insert(instr.GetParam<std::string>(0));
+		}
+
+		std::map<std::string, std::string> slots;
+		for (size_t i = 0; i < size; ++i) {
+			RuntimeInstr& instr = code[i];
+			std::vector<size_t> names;
+			if (instr.opcode == RuntimeInstrType::RangeNext)
+				names = { 2, 3 };
+			else if (!instr.GetDefinedVars().empty())
+				names = { 0 };
+			auto [first, last] = instr.GetUsedParams();
+			for (size_t p = first; p < last; ++p) {
+				names.push_back(p);
+			}
+			if (instr.opcode == RuntimeInstrType::Operation && instr.GetParam<ERuntimeCallType>(1) == ERuntimeCallType::Assign)
+				names.push_back(2);
+
+			for (size_t p : names) {
+				std::string& name = instr.RefParam<std::string>(p);
+				if (name.empty() || name[0] != '$' || escaping.count(name))
+					continue;
+				auto it = slots.try_emplace(name, "#" + std::to_string(slots.size())).first;
+				name = it->second;
+			}
+		}
+		method->SetFrameSlots(slots.size());
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "Runtime.h"
+#include "ControlFlow.h"
+
+class Optimizer
+{
+private:
+	// opcode, operator, value numbers of the operands (constant bytes for Ctor)
+	using ValueKey = std::tuple<RuntimeInstrType, ERuntimeCallType, std::vector<int64_t>>;
+
+	static int64_t GetJumpTarget(const std::vector<RuntimeInstr>& code, int64_t idx);
+	static int64_t FindTempDefinition(const RuntimeInstr* code, int64_t idx, const std::string& name);
+	static bool IsIntConst(const std::vector<RuntimeInstr>& code, int64_t idx, const std::string& name, int64_t& value);
+	static bool MayMutateArgs(RuntimeCtx* ctx, const RuntimeInstr& instr);
+	static bool IsHoistable(const RuntimeInstr& instr);
+	static void HoistLoop(RuntimeCtx* ctx, ControlFlowGraph& cfg, const Loop& loop);
+	static void RenameTemps(RuntimeInstr& instr, const std::map<std::string, std::string>& renamed);
+	static bool GetValueKey(const RuntimeInstr& instr, std::map<std::string, int64_t>& numbers, int64_t& nextNumber, ValueKey& key);
+	static bool WritesParams(RuntimeCtx* ctx, RuntimeMethod* method);
+	static RuntimeVar* EvaluateConstant(RuntimeCtx* ctx, RuntimeExecutor& sandbox, const RuntimeInstr* code, int64_t idx, const std::string& name);
+	static bool EvaluateCall(RuntimeCtx* ctx, RuntimeMethod* method, const RuntimeInstr* code, int64_t idx, uint64_t& budget, RuntimeInstr& folded);
+
+public:
+	// Rewrites `Operation ArrayAccess` into the unchecked `ArrayAccess` instruction for loops of the form
+	// `i = c0; while (i < len(a)) { ... a[i] ... i = i + c1; }` (c0, c1 >= 0), which also covers the for-in desugaring.
+	// Expects rebased (relative) jumps. The "bounds-check-elimination" pass, off with -no-pass=bounds-check-elimination.
+	static void EliminateBoundsChecks(RuntimeCtx* ctx, std::vector<RuntimeInstr>& code);
+
+	// Loop-invariant code motion, innermost loops first. Constructors and invariant work in the loop header move to a
+	// preheader; invariant work from the body that may fail at runtime moves to a landing pad that only runs when the loop
+	// is entered, and the loop is rotated so the pad runs once, its copy of the header defining fresh temporaries.
+	static void HoistLoopInvariants(RuntimeCtx* ctx, ControlFlowGraph& cfg);
+
+	// Local value numbering: within a block, a constant, pure operator or array access repeating an earlier one on the
+	// same values is dropped and its temporary renamed to the earlier result. Assignments through element aliases and
+	// natives that may write their arguments invalidate everything read from arrays.
+	static void NumberValues(RuntimeCtx* ctx, ControlFlowGraph& cfg);
+
+	// Drops constructors and assignments whose SSA value is never read.
+	static void RemoveDeadStores(RuntimeCtx* ctx, ControlFlowGraph& cfg);
+
+	// Marks script methods pure when they only call pure methods and never write through their parameters, so
+	// their result depends on the argument values alone. Optimistic, recursive methods stay pure. Run after every
+	// method is lowered.
+	static void AnalyzePurity(RuntimeCtx* ctx);
+
+	// Runs calls of pure script methods whose arguments are all constants in a sandboxed executor and
+	// replaces them with the result: a Ctor for scalars, a Const copy for arrays and ranges. An argument is constant
+	// when it is built by a Ctor, or by an operator over constants such as `-3` or `2 + 3`. Calls that fail or hit
+	// the sandbox limits are left for runtime. All calls share one step budget, and memoized callees are left alone
+	// since the sandbox runs them without their cache. Expects AnalyzePurity to have run, and memo flags not yet set.
+	static void FoldConstantCalls(RuntimeCtx* ctx);
+
+	// Escape analysis for temporaries: every value leaving a call is copied (parameters, return values, array
+	// elements, memo results), so only temporaries aliasing an array element outlive the frame. The others are
+	// renamed to numbered frame slots (`#n`) that the executor takes from its VarRegion on entry and drops in one step
+	// on return. Runs last, after every pass that looks for `$` temporaries.
+	static void AllocateFrameSlots(RuntimeCtx* ctx);
+};
@@ -124,13 +124,40 @@ void Parser::Precompile() {
     addResv("int", 1);
     addResv("append", 2);
     addResv("len", 1);
+    addResv("range", -1);
+    addResv("dict", -1);
+    addResv("get", 2);
+    addResv("set", 3);
+    addResv("has", 2);
+    addResv("remove", 2);
+    addResv("bitset", 1);
+    addResv("setbit", 2);
+    addResv("clearbit", 2);
+    addResv("testbit", 2);
+    addResv("popcount", 1);
+    addResv("bitand", 2);
+    addResv("bitor", 2);
+    addResv("bitxor", 2);
+    addResv("bitandnot", 2);
+    addResv("heap", -1);
+    addResv("push", 2);
+    addResv("pop", 1);
+    addResv("peek", 1);
+    addResv("deque", 0);
+    addResv("pushfront", 2);
+    addResv("pushback", 2);
+    addResv("popfront", 1);
+    addResv("popback", 1);
+    addResv("sortedmap", -1);
+    addResv("lowerbound", 2);
+    addResv("upperbound", 2);
 }
 
 Poliz Parser::Program() {
     Poliz programPoliz;
 	try {
 		bool wasMain = false;
-		while (curLexeme_.string == "function" || curLexeme_.string == "class") {
+		while (curLexeme_.string == "function" || curLexeme_.string == "class" || curLexeme_.string == "memo") {
 
             if (curLexeme_.string == "class") {
                 ReadLexeme();
@@ -158,6 +185,13 @@ Poliz Parser::Program() {
                 ReadLexeme();
 				this->currentClass = "";
             } else {
+				this->isMemoFunction = curLexeme_.string == "memo";
+				if (this->isMemoFunction) {
+					ReadLexeme();
+					if (curLexeme_.string != "function") {
+						throw ParserException(curLexeme_, this->currentLexemeIdx, "expected function after memo");
+					}
+				}
 
                 ReadLexeme();
 				DeclaredFunction procFunction;
@@ -166,6 +200,9 @@ Poliz Parser::Program() {
                     throw ParserException(curLexeme_, this->currentLexemeIdx,
                                           "function " + curLexeme_.string + " declared multiple times");
                 if (curLexeme_.string == "main") {
+					if (this->isMemoFunction) {
+						throw ParserException(curLexeme_, this->currentLexemeIdx, "main can not be memo");
+					}
 					procFunction.numArgs = 0;
 					this->declaredFunctions[this->currentClass].insert(procFunction);
 
@@ -229,6 +266,8 @@ Poliz Parser::Function() {
 	if (!this->currentClass.empty() && this->declaredFunctions[this->currentClass].find(func) != this->declaredFunctions[this->currentClass].end())
 		throw ParserException(curLexeme_, this->currentLexemeIdx, "function " + curLexeme_.string + " declared multiple times");
 	func.numArgs = 0;
+	func.memo = this->isMemoFunction;
+	this->isMemoFunction = false;
 	ReadLexeme();
 	if (curLexeme_.string != "(") {
 		throw ParserException(curLexeme_, this->currentLexemeIdx, "there is no opening bracket in function declaration");
@@ -321,12 +360,13 @@ Poliz Parser::Priority1() {
 	auto res = Priority2();
 	ReadLexeme();
 	while (curLexeme_.string == "||") {
-        auto cmd = curLexeme_.string;
         ReadLexeme();
         auto operand = Priority2();
         ReadLexeme();
+        // the right side is skipped once the left one is true
+        res.addEntry(PolizCmd::OrJump, std::to_string(operand.GetSize() + 2), currentLexemeIdx);
         res += operand;
-        res.addEntry(PolizCmd::Operation, cmd, currentLexemeIdx);
+        res.addEntry(PolizCmd::Test, "", currentLexemeIdx);
 	}
 	this->MovePtr(-1);
     return res;
@@ -336,12 +376,13 @@ Poliz Parser::Priority2() {
 	auto res = Priority3();
 	ReadLexeme();
 	while (curLexeme_.string == "&&") {
-        auto cmd = curLexeme_.string;
         ReadLexeme();
         auto operand = Priority3();
         ReadLexeme();
+        // the right side is skipped once the left one is false
+        res.addEntry(PolizCmd::AndJump, std::to_string(operand.GetSize() + 2), currentLexemeIdx);
         res += operand;
-        res.addEntry(PolizCmd::Operation, cmd, currentLexemeIdx);
+        res.addEntry(PolizCmd::Test, "", currentLexemeIdx);
 	}
 	this->MovePtr(-1);
     return res;
@@ -515,7 +556,7 @@ std::pair<int, Poliz> Parser::Arguments() {
 }
 
 Poliz Parser::Container() {
-    return MultivariateAnalyse({&Parser::FunctionCall, &Parser::List, &Parser::String });
+    return MultivariateAnalyse({&Parser::FunctionCall, &Parser::List, &Parser::String, &Parser::DictLiteral });
 }
 
 Poliz Parser::String() {
@@ -537,7 +578,10 @@ Poliz Parser::Name() {
 	DeclaredFunction func;
 	func.name = curLexeme_.string;
 	func.numArgs = -1;
-	bool isFunction = this->declaredFunctions[this->currentClass].find(func) != this->declaredFunctions[this->currentClass].end();
+	// a function name only names the function when it is called, so builtins like set or get stay usable as variables
+	size_t next = this->currentLexemeIdx + 1;
+	bool isCalled = next < this->input_.size() && this->input_[next].string == "(";
+	bool isFunction = isCalled && this->declaredFunctions[this->currentClass].find(func) != this->declaredFunctions[this->currentClass].end();
 	if (!this->isInFuncCall) {
 		if (isFunction) {
 			throw ParserException(curLexeme_, this->currentLexemeIdx, "unable to reference function");
@@ -683,12 +727,47 @@ Poliz Parser::TemporaryList() {
     return res;
 }
 
+// {k1: v1, k2: v2, ...} is a dict() call with the pairs flattened into its arguments
+Poliz Parser::DictLiteral() {
+	if (curLexeme_.string != "{") {
+		throw ParserException(curLexeme_, this->currentLexemeIdx, "expected opening curly bracket in dict declaration");
+	}
+	ReadLexeme();
+    std::stack<Poliz> stackArgs;
+	while (curLexeme_.string != "}") {
+        stackArgs.push(ValueExp());
+		ReadLexeme();
+		if (curLexeme_.string != ":") {
+			throw ParserException(curLexeme_, this->currentLexemeIdx, "expected colon after dict key");
+		}
+		ReadLexeme();
+        stackArgs.push(ValueExp());
+		ReadLexeme();
+		if (curLexeme_.string != ",")
+			break;
+		ReadLexeme();
+	}
+	if (curLexeme_.string != "}") {
+		throw ParserException(curLexeme_, this->currentLexemeIdx, "expected closing curly bracket in dict declaration");
+	}
+
+    Poliz res;
+    size_t numArgs = stackArgs.size();
+    while (!stackArgs.empty()) {
+        res += stackArgs.top();
+        stackArgs.pop();
+    }
+    res.addEntry(PolizCmd::ConstInt, std::to_string(numArgs), currentLexemeIdx);
+    res.addEntry(PolizCmd::Call, "dict", currentLexemeIdx);
+    return res;
+}
+
 Poliz Parser::InputArguments() {
 	return MultivariateAnalyse({ &Parser::Name, &Parser::ListElement });
 }
 
 Poliz Parser::ConditionalSpecialOperators() {
-    return MultivariateAnalyse({ &Parser::For, &Parser::While, &Parser::If });
+    return MultivariateAnalyse({ &Parser::For, &Parser::While, &Parser::If, &Parser::Switch });
 }
 
 Poliz Parser::If() {
@@ -765,6 +844,26 @@ Poliz Parser::For() {
 	ReadLexeme();
 	auto block = Block();
 
+    if (container.getLastEntryType() == PolizCmd::Call && container.getLastEntry().operand == "range") {
+        // range() only yields Int64, so iterate it with a native induction variable instead of ArraySize/ArrayAccess
+        res.addEntry(PolizCmd::Var, tmpVarName, currentLexemeIdx);
+        res += container;
+        res.addEntry(PolizCmd::Operation, "=", currentLexemeIdx);
+        res.addEntry(PolizCmd::Var, tmpItrName, currentLexemeIdx);
+        res.addEntry(PolizCmd::Var, tmpVarName, currentLexemeIdx);
+        res.addEntry(PolizCmd::RangeInit, "", currentLexemeIdx);
+
+        int conditionFlag = res.GetSize();
+
+        res += itr;
+        res.addEntry(PolizCmd::Var, tmpItrName, currentLexemeIdx);
+        res.addEntry(PolizCmd::Var, tmpVarName, currentLexemeIdx);
+        res.addEntry(PolizCmd::RangeNext, std::to_string(block.GetSize() + 2), currentLexemeIdx);
+        res += block;
+        res.addEntry(PolizCmd::Jump, std::to_string(conditionFlag - res.GetSize()), currentLexemeIdx);
+        --nextTmpVarSuffix;
+        return res;
+    }
 
     res.addEntry(PolizCmd::Var, tmpVarName, currentLexemeIdx);
     res += container;
@@ -819,6 +918,99 @@ Poliz Parser::While() {
     return val;
 }
 
+Poliz Parser::Switch() {
+	if (curLexeme_.string != "switch") {
+		throw ParserException(curLexeme_, this->currentLexemeIdx, "invalid switch operator");
+	}
+	ReadLexeme();
+	if (curLexeme_.string != "(") {
+		throw ParserException(curLexeme_, this->currentLexemeIdx, "expected opening bracket in switch structure");
+	}
+	ReadLexeme();
+	auto val = ValueExp();
+	ReadLexeme();
+	if (curLexeme_.string != ")") {
+		throw ParserException(curLexeme_, this->currentLexemeIdx, "expected closing bracket in switch structure");
+	}
+	ReadLexeme();
+	if (curLexeme_.string != "{") {
+		throw ParserException(curLexeme_, this->currentLexemeIdx, "there is no opening curly bracket in switch structure");
+	}
+	ReadLexeme();
+
+	// cases do not fall through, every body ends with a jump past the switch
+	std::vector<std::pair<PolizCmd, std::string>> keys;
+	std::set<std::string> seen;
+	std::vector<Poliz> bodies;
+	Poliz defaultBlock;
+	bool hasDefault = false;
+	while (curLexeme_.string != "}") {
+		if (curLexeme_.string == "default") {
+			if (hasDefault) {
+				throw ParserException(curLexeme_, this->currentLexemeIdx, "default declared twice in switch structure");
+			}
+			hasDefault = true;
+			ReadLexeme();
+			if (curLexeme_.string != ":") {
+				throw ParserException(curLexeme_, this->currentLexemeIdx, "expected colon after default");
+			}
+			ReadLexeme();
+			defaultBlock = Block();
+			ReadLexeme();
+			continue;
+		}
+		if (curLexeme_.string != "case") {
+			throw ParserException(curLexeme_, this->currentLexemeIdx, "expected case or default in switch structure");
+		}
+		if (hasDefault) {
+			throw ParserException(curLexeme_, this->currentLexemeIdx, "case after default in switch structure");
+		}
+		ReadLexeme();
+		bool negative = curLexeme_.string == "-";
+		if (negative) {
+			ReadLexeme();
+		}
+		std::pair<PolizCmd, std::string> key;
+		if (curLexeme_.type == ELexemeType::LiteralNum32 || curLexeme_.type == ELexemeType::LiteralNum64) {
+			key = { PolizCmd::ConstInt, std::to_string(std::stoll((negative ? "-" : "") + curLexeme_.string)) };
+		}
+		else if (!negative && (curLexeme_.type == ELexemeType::LiteralStr || curLexeme_.type == ELexemeType::LiteralChar)) {
+			key = { PolizCmd::Str, curLexeme_.string };
+		}
+		else {
+			throw ParserException(curLexeme_, this->currentLexemeIdx, "case value must be an integer or string literal");
+		}
+		if (!seen.insert((key.first == PolizCmd::Str ? "s" : "i") + key.second).second) {
+			throw ParserException(curLexeme_, this->currentLexemeIdx, "duplicate case in switch structure");
+		}
+		ReadLexeme();
+		if (curLexeme_.string != ":") {
+			throw ParserException(curLexeme_, this->currentLexemeIdx, "expected colon after case value");
+		}
+		ReadLexeme();
+		keys.push_back(key);
+		bodies.push_back(Block());
+		ReadLexeme();
+	}
+
+	// <value> (<key> Case)... Switch <body> Jump ... <default>
+	int64_t switchIdx = val.GetSize() + 2 * keys.size();
+	int64_t bodyStart = switchIdx + 1;
+	for (size_t k = 0; k < keys.size(); ++k) {
+		val.addEntry(keys[k].first, keys[k].second, currentLexemeIdx);
+		val.addEntry(PolizCmd::Case, std::to_string(bodyStart - val.GetSize()), currentLexemeIdx);
+		bodyStart += bodies[k].GetSize() + 1;
+	}
+	val.addEntry(PolizCmd::Switch, std::to_string(bodyStart - switchIdx), currentLexemeIdx);
+	int64_t end = bodyStart + defaultBlock.GetSize();
+	for (auto& body : bodies) {
+		val += body;
+		val.addEntry(PolizCmd::Jump, std::to_string(end - val.GetSize()), currentLexemeIdx);
+	}
+	val += defaultBlock;
+	return val;
+}
+
 Poliz Parser::MultivariateAnalyse(const std::vector<Poliz (Parser::*)()>& variants, bool isCheckEndLineSymbol, bool isAssign) {
 	int64_t pos = (int64_t)this->currentLexemeIdx - 1;
 	bool flag = true;
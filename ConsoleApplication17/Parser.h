@@ -31,6 +31,7 @@ struct DeclaredFunction {
 	string name;
 	int numArgs;
 	std::vector<string> argNames;
+	bool memo = false;
 
 	bool operator==(const DeclaredFunction& ex) const {
 		return ex.name == this->name && (ex.numArgs < 0 || this->numArgs < 0 || this->numArgs == ex.numArgs);
@@ -64,6 +65,7 @@ private:
 	FunctionScope* currentScope;
 	bool isInAssign = false;
 	bool isInFuncCall = false;
+	bool isMemoFunction = false;
 	string lastReadName;
     Poliz poliz;
     int nextTmpVarSuffix = 0;
@@ -109,12 +111,14 @@ private:
     Poliz Assign();
 	void VariableDeclaration();
     Poliz TemporaryList();
+    Poliz DictLiteral();
     Poliz InputArguments();
     Poliz ConditionalSpecialOperators();
     Poliz If();
     Poliz Else();
     Poliz For();
     Poliz While();
+    Poliz Switch();
     Poliz MultivariateAnalyse(const std::vector<Poliz (Parser::*)()>& variants, bool isCheckEndLineSymbol = false, bool isAssign = false);
 	
 	bool FunctionExists(string name) {
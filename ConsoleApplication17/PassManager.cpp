@@ -0,0 +1,133 @@
+#include "PassManager.h"
+#include "Optimizer.h"
+#include "SSA.h"
+#include <iostream>
+
+void PassManager::AddPass(const std::string& name, EOptLevel minLevel, Pass pass) {
+	this->passes.push_back({ name, minLevel, pass });
+}
+
+bool PassManager::HasPass(const std::string& name) const {
+	return std::any_of(this->passes.begin(), this->passes.end(), [&](const PassEntry& entry) { return entry.name == name; });
+}
+
+void PassManager::Run(RuntimeCtx* ctx, ControlFlowGraph& cfg) const {
+	std::string stage = "lowering";
+	for (size_t i = 0; i <= this->passes.size(); ++i) {
+#ifndef NDEBUG
+		std::string error;
+		if (!Verify(cfg, error)) {
+			std::cout << "IR verification failed after " << stage << ": " << error << std::endl;
+			assert(false);
+		}
+#endif
+		if (i == this->passes.size())
+			break;
+		const PassEntry& entry = this->passes[i];
+		if (entry.minLevel > this->level || this->disabled.count(entry.name))
+			continue;
+		entry.pass(ctx, cfg);
+		stage = entry.name;
+	}
+}
+
+PassManager PassManager::CreateDefault(EOptLevel level, const std::set<std::string>& disabled) {
+	PassManager manager(level);
+	manager.disabled = disabled;
+	manager.AddPass("bounds-check-elimination", EOptLevel::O1, [](RuntimeCtx* ctx, ControlFlowGraph& cfg) {
+		// pattern-matches loops on linear code
+		std::vector<RuntimeInstr> code = cfg.Flatten();
+		Optimizer::EliminateBoundsChecks(ctx, code);
+		cfg = ControlFlowGraph(code);
+	});
+	manager.AddPass("loop-invariant-code-motion", EOptLevel::O2, Optimizer::HoistLoopInvariants);
+	manager.AddPass("value-numbering", EOptLevel::O1, Optimizer::NumberValues);
+	manager.AddPass("dead-store-elimination", EOptLevel::O1, Optimizer::RemoveDeadStores);
+	return manager;
+}
+
+bool PassManager::Verify(const ControlFlowGraph& cfg, std::string& error) {
+	const size_t count = cfg.GetBlockCount();
+	std::vector<int> layoutCount(count, 0);
+	for (int id : cfg.GetLayout()) {
+		if (id < 0 || id >= (int)count || layoutCount[id]++) {
+			error = "block " + std::to_string(id) + " is not laid out exactly once";
+			return false;
+		}
+	}
+	if (cfg.GetLayout().size() != count) {
+		error = "layout misses blocks";
+		return false;
+	}
+
+	std::vector<std::multiset<int>> preds(count);
+	for (size_t id = 0; id < count; ++id) {
+		const BasicBlock& block = cfg.GetBlock(id);
+		std::string where = "block " + std::to_string(id) + ": ";
+		for (size_t i = 0; i + 1 < block.instrs.size(); ++i) {
+			if (block.instrs[i].IsJump() || block.instrs[i].opcode == RuntimeInstrType::Ret) {
+				error = where + RuntimeInstrType_ToString(block.instrs[i].opcode) + " in the middle of the block";
+				return false;
+			}
+		}
+		bool jump = !block.instrs.empty() && block.instrs.back().IsJump();
+		bool falls = block.instrs.empty() || !(block.instrs.back().opcode == RuntimeInstrType::Ret || block.instrs.back().opcode == RuntimeInstrType::Jmp || block.instrs.back().opcode == RuntimeInstrType::Switch);
+		if (jump != (block.jumpTarget >= 0) || block.jumpTarget >= (int)count) {
+			error = where + "jump target does not match the last instruction";
+			return false;
+		}
+		size_t slots = jump ? block.instrs.back().GetJumpDeltas().size() - 1 : 0;
+		if (slots != block.caseTargets.size() || std::any_of(block.caseTargets.begin(), block.caseTargets.end(), [&](int t) { return t < 0 || t >= (int)count; })) {
+			error = where + "case targets do not match the switch table";
+			return false;
+		}
+		if ((!falls && block.fallthrough >= 0) || block.fallthrough >= (int)count) {
+			error = where + "fallthrough after Ret, Jmp or Switch";
+			return false;
+		}
+		if (cfg.IsReachable(id) && falls && block.fallthrough < 0) {
+			error = where + "runs past the end of the method";
+			return false;
+		}
+		for (int succ : block.GetSuccessors()) {
+			preds[succ].insert(id);
+		}
+	}
+	for (size_t id = 0; id < count; ++id) {
+		const auto& stored = cfg.GetBlock(id).preds;
+		if (preds[id] != std::multiset<int>(stored.begin(), stored.end())) {
+			error = "block " + std::to_string(id) + ": stale predecessors";
+			return false;
+		}
+	}
+
+	SSAForm ssa(cfg);
+	std::function<bool(int, std::set<int>&)> defined = [&](int value, std::set<int>& visited) {
+		const SSAValue& v = ssa.GetValue(value);
+		if (v.kind == SSAValue::EKind::Entry)
+			return false;
+		if (v.kind == SSAValue::EKind::Instr || !visited.insert(value).second)
+			return true;
+		for (int arg : v.args) {
+			if (arg >= 0 && !defined(arg, visited))
+				return false;
+		}
+		return true;
+	};
+	for (int id : cfg.GetLayout()) {
+		if (!cfg.IsReachable(id))
+			continue;
+		const BasicBlock& block = cfg.GetBlock(id);
+		for (size_t i = 0; i < block.instrs.size(); ++i) {
+			for (int value : ssa.GetUses(id, i)) {
+				const std::string& var = ssa.GetValue(value).var;
+				std::set<int> visited;
+				if (!var.empty() && var[0] == '$' && !defined(value, visited)) {
+					error = "block " + std::to_string(id) + ": " + var + " may be read before it is defined";
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "ControlFlow.h"
+
+// Runs the optimization pipeline over a method's blocks. Passes above the selected level and disabled passes are
+// skipped; debug builds verify the graph before the first pass and after every pass.
+class PassManager {
+public:
+	using Pass = std::function<void(RuntimeCtx*, ControlFlowGraph&)>;
+
+	explicit PassManager(EOptLevel level) : level(level) {}
+
+	void AddPass(const std::string& name, EOptLevel minLevel, Pass pass);
+	bool HasPass(const std::string& name) const;
+	// skips the named pass whatever the level, e.g. to keep bounds checks
+	void DisablePass(const std::string& name) { this->disabled.insert(name); }
+	void Run(RuntimeCtx* ctx, ControlFlowGraph& cfg) const;
+
+	// the pipeline used by RuntimeMethod::FromPoliz, without the passes the context disables
+	static PassManager CreateDefault(EOptLevel level, const std::set<std::string>& disabled = {});
+
+	// block structure, edges and SSA: temporaries are defined on every path to their uses
+	static bool Verify(const ControlFlowGraph& cfg, std::string& error);
+
+private:
+	struct PassEntry {
+		std::string name;
+		EOptLevel minLevel;
+		Pass pass;
+	};
+
+	EOptLevel level;
+	std::vector<PassEntry> passes;
+	std::set<std::string> disabled;
+};
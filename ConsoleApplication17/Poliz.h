@@ -24,6 +24,13 @@ enum class PolizCmd {
     ArrayAccess,
     ArraySize,
     UnOperation,
+    RangeInit,
+    RangeNext,
+    AndJump,
+    OrJump,
+    Test,
+    Case,
+    Switch,
     Ret,
     Null
 };
@@ -43,6 +50,13 @@ inline std::string PolizCmdToStr(PolizCmd cmd){
         case PolizCmd::ArraySize:       return "ArraySize";
         case PolizCmd::Operation:       return "Operation";
         case PolizCmd::UnOperation:     return "UnOperation";
+        case PolizCmd::RangeInit:       return "RangeInit";
+        case PolizCmd::RangeNext:       return "RangeNext";
+        case PolizCmd::AndJump:         return "AndJump";
+        case PolizCmd::OrJump:          return "OrJump";
+        case PolizCmd::Test:            return "Test";
+        case PolizCmd::Case:            return "Case";
+        case PolizCmd::Switch:          return "Switch";
         case PolizCmd::Ret:             return "Ret";
         case PolizCmd::Null:            return "Null";
         default:                        return "[Unknown cmd]";
@@ -1,10 +1,32 @@
 #include "Precompile.h"
+#include "Dict.h"
+#include "Bitset.h"
+#include "Heap.h"
+#include "Deque.h"
+#include "SortedMap.h"
+#include <charconv>
+#include <limits>
+
+RuntimeVar* Precompile::RepeatString(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* str, int64_t count) {
+	size_t size = str->data.str.size;
+	// the length has to fit the string's size field, and size * count must not wrap on the way there
+	constexpr uint64_t maxSize = std::numeric_limits<decltype(str->data.str.size)>::max();
+	if (size && (uint64_t)count > maxSize / size) {
+		exec->SetError("String too long: " + std::to_string(size) + " * " + std::to_string(count) + " chars, at most " + std::to_string(maxSize));
+		return nullptr;
+	}
+	if (!exec->ReserveBytes(size * count + 1))
+		return nullptr;
+	RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::String));
+	ret->ConstructString(nullptr, size * count);
+	for (size_t offset = 0; offset < size * count; offset += size) {
+		std::copy_n(str->data.str.ptr, size, ret->data.str.ptr + offset);
+	}
+	return ret;
+}
 
 RuntimeType* Precompile::Type_Null() {
 	RuntimeType* type = new RuntimeType("Null", ERuntimeType::Null, 0);
-	type->SetNativeCtor([](RuntimeVar* var, ByteStream& stream) {
-
-	});
 	type->SetNativeTypeConvert([](RuntimeVar* var, RuntimeType* type) -> bool {
 		
 		var->data.i64 = 0;
@@ -27,9 +49,8 @@ RuntimeType* Precompile::Type_Null() {
 
 RuntimeType* Precompile::Type_Int64() {
 	RuntimeType* type = new RuntimeType("Int64", ERuntimeType::Int64, 8);
-	type->SetNativeCtor([](RuntimeVar* var, ByteStream& stream) {
-		var->data.i64 = stream.Read<int64_t>();
-		//printf("Int64: %p -> %d\n", var, var->data.i64);
+	type->SetIntCtor([](RuntimeVar* var, int64_t value) {
+		var->data.i64 = value;
 	});
 
 	type->SetNativeTypeConvert([](RuntimeVar* var, RuntimeType* type) -> bool {
@@ -39,9 +60,9 @@ RuntimeType* Precompile::Type_Int64() {
 			return true;
 		}
 		else if (type->GetTypeEnum() == ERuntimeType::String) { // Int64 -> String
-			ByteStream stream;
-			stream.Write(std::to_string(var->data.i64));
-			type->NativeCtor(var, stream);
+			char buf[24];
+			auto res = std::to_chars(buf, buf + sizeof(buf), var->data.i64);
+			type->ConstructString(var, buf, res.ptr - buf);
 			return true;
 		}
 		else if (type->GetTypeEnum() == ERuntimeType::Double) {
@@ -55,9 +76,7 @@ RuntimeType* Precompile::Type_Int64() {
 	type->SetOperator(ERuntimeCallType::Add, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
 		ERuntimeType targetType = p2->GetType()->GetTypeEnum();
 		if (targetType == ERuntimeType::Int64) {
-			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-			ret->data.i64 = p1->data.i64 + p2->data.i64;
-			return ret;
+			return exec->CreateInt64(ctx, p1->data.i64 + p2->data.i64);
 		}
 		else if (targetType == ERuntimeType::Double) {
 			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Double));
@@ -70,9 +89,7 @@ RuntimeType* Precompile::Type_Int64() {
 	type->SetOperator(ERuntimeCallType::Sub, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
 		ERuntimeType targetType = p2->GetType()->GetTypeEnum();
 		if (targetType == ERuntimeType::Int64) {
-			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-			ret->data.i64 = p1->data.i64 - p2->data.i64;
-			return ret;
+			return exec->CreateInt64(ctx, p1->data.i64 - p2->data.i64);
 		}
 		else if (targetType == ERuntimeType::Double) {
 			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Double));
@@ -85,9 +102,7 @@ RuntimeType* Precompile::Type_Int64() {
 	type->SetOperator(ERuntimeCallType::Mult, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
 		ERuntimeType targetType = p2->GetType()->GetTypeEnum();
 		if (targetType == ERuntimeType::Int64) {
-			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-			ret->data.i64 = p1->data.i64 * p2->data.i64;
-			return ret;
+			return exec->CreateInt64(ctx, p1->data.i64 * p2->data.i64);
 		}
 		else if (targetType == ERuntimeType::Double) {
 			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Double));
@@ -99,16 +114,7 @@ RuntimeType* Precompile::Type_Int64() {
 				exec->SetError("Illegal operation: " + p1->GetType()->GetName() + " * " + p2->GetType()->GetName() + ", int should be positive");
 				return nullptr;
 			}
-			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::String));
-			std::string s;
-			std::string cp = std::string(p2->data.str.ptr, p2->data.str.ptr + p2->data.str.size);
-			for (int64_t i = 0; i < p1->data.i64; ++i) {
-				s += cp;
-			}
-			ByteStream stream;
-			stream.Write(s);
-			ret->GetType()->NativeCtor(ret, stream);
-			return ret;
+			return RepeatString(ctx, exec, p2, p1->data.i64);
 		}
 		exec->SetError("Illegal operation: " + p1->GetType()->GetName() + " * " + p2->GetType()->GetName());
 		return nullptr;
@@ -139,14 +145,10 @@ RuntimeType* Precompile::Type_Int64() {
 	type->SetOperator(ERuntimeCallType::IntDiv, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
 		ERuntimeType targetType = p2->GetType()->GetTypeEnum();
 		if (targetType == ERuntimeType::Int64) {
-			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-			ret->data.i64 = p1->data.i64 / p2->data.i64;
-			return ret;
+			return exec->CreateInt64(ctx, p1->data.i64 / p2->data.i64);
 		}
 		else if (targetType == ERuntimeType::Double) {
-			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-			ret->data.i64 = p1->data.i64 / p2->data.dbl;
-			return ret;
+			return exec->CreateInt64(ctx, p1->data.i64 / p2->data.dbl);
 		}
 		exec->SetError("Illegal operation: " + p1->GetType()->GetName() + " // " + p2->GetType()->GetName());
 		return nullptr;
@@ -154,43 +156,34 @@ RuntimeType* Precompile::Type_Int64() {
 	type->SetOperator(ERuntimeCallType::Remainder, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
 		ERuntimeType targetType = p2->GetType()->GetTypeEnum();
 		if (targetType == ERuntimeType::Int64) {
-			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-			ret->data.i64 = p1->data.i64 % p2->data.i64;
-			return ret;
+			return exec->CreateInt64(ctx, p1->data.i64 % p2->data.i64);
 		}
 		exec->SetError("Illegal operation: " + p1->GetType()->GetName() + " % " + p2->GetType()->GetName());
 		return nullptr;
 	});
 
 	type->SetOperator(ERuntimeCallType::UnMinus, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
-		RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-		ret->data.i64 = -p1->data.i64;
-		return ret;
+		return exec->CreateInt64(ctx, -p1->data.i64);
 	});
 
 	type->SetOperator(ERuntimeCallType::CompareEq, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
 		ERuntimeType targetType = p2->GetType()->GetTypeEnum();
-		RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-		ret->data.i64 = 0;
+		bool eq = false;
 		if (targetType == ERuntimeType::Int64) {
-			ret->data.i64 = p1->data.i64 == p2->data.i64;
+			eq = p1->data.i64 == p2->data.i64;
 		}
 		else if (targetType == ERuntimeType::Double) {
-			ret->data.i64 = (double)p1->data.i64 == p2->data.dbl;
+			eq = (double)p1->data.i64 == p2->data.dbl;
 		}
-		return ret;
+		return exec->CreateInt64(ctx, eq);
 	});
 	type->SetOperator(ERuntimeCallType::CompareLess, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
 		ERuntimeType targetType = p2->GetType()->GetTypeEnum();
 		if (targetType == ERuntimeType::Int64) {
-			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-			ret->data.i64 = p1->data.i64 < p2->data.i64;
-			return ret;
+			return exec->CreateInt64(ctx, p1->data.i64 < p2->data.i64);
 		}
 		else if (targetType == ERuntimeType::Double) {
-			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-			ret->data.i64 = p1->data.i64 < p2->data.dbl;
-			return ret;
+			return exec->CreateInt64(ctx, p1->data.i64 < p2->data.dbl);
 		}
 		exec->SetError("Illegal operation: " + p1->GetType()->GetName() + " < " + p2->GetType()->GetName());
 		return nullptr;
@@ -200,9 +193,8 @@ RuntimeType* Precompile::Type_Int64() {
 
 RuntimeType* Precompile::Type_Double() {
 	RuntimeType* type = new RuntimeType("Double", ERuntimeType::Double, 8);
-	type->SetNativeCtor([](RuntimeVar* var, ByteStream& stream) {
-		var->data.dbl = stream.Read<double>();
-		//printf("Double: %p -> %.2f\n", var, (float)var->data.dbl);
+	type->SetDoubleCtor([](RuntimeVar* var, double value) {
+		var->data.dbl = value;
 	});
 
 	type->SetNativeTypeConvert([](RuntimeVar* var, RuntimeType* type) -> bool {
@@ -213,9 +205,9 @@ RuntimeType* Precompile::Type_Double() {
 			return true;
 		}
 		else if (type->GetTypeEnum() == ERuntimeType::String) { // Double -> String
-			ByteStream stream;
-			stream.Write(std::to_string(var->data.dbl));
-			type->NativeCtor(var, stream);
+			char buf[512]; // "%f" of the largest double is 316 chars
+			int len = snprintf(buf, sizeof(buf), "%f", var->data.dbl);
+			type->ConstructString(var, buf, len);
 			return true;
 		}
 		else if (type->GetTypeEnum() == ERuntimeType::Int64) { // Double -> Int64
@@ -311,27 +303,22 @@ RuntimeType* Precompile::Type_Double() {
 
 	type->SetOperator(ERuntimeCallType::CompareEq, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
 		ERuntimeType targetType = p2->GetType()->GetTypeEnum();
-		RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-		ret->data.i64 = 0;
+		bool eq = false;
 		if (targetType == ERuntimeType::Int64) {
-			ret->data.i64 = p1->data.dbl == (double)p2->data.i64;
+			eq = p1->data.dbl == (double)p2->data.i64;
 		}
 		else if (targetType == ERuntimeType::Double) {
-			ret->data.i64 = p1->data.dbl == p2->data.dbl;
+			eq = p1->data.dbl == p2->data.dbl;
 		}
-		return ret;
+		return exec->CreateInt64(ctx, eq);
 	});
 	type->SetOperator(ERuntimeCallType::CompareLess, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
 		ERuntimeType targetType = p2->GetType()->GetTypeEnum();
 		if (targetType == ERuntimeType::Int64) {
-			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-			ret->data.i64 = p1->data.dbl < p2->data.i64;
-			return ret;
+			return exec->CreateInt64(ctx, p1->data.dbl < p2->data.i64);
 		}
 		else if (targetType == ERuntimeType::Double) {
-			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-			ret->data.i64 = p1->data.dbl < p2->data.dbl;
-			return ret;
+			return exec->CreateInt64(ctx, p1->data.dbl < p2->data.dbl);
 		}
 		exec->SetError("Illegal operation: " + p1->GetType()->GetName() + " < " + p2->GetType()->GetName());
 		return nullptr;
@@ -341,18 +328,26 @@ RuntimeType* Precompile::Type_Double() {
 
 RuntimeType* Precompile::Type_String() {
 	RuntimeType* type = new RuntimeType("String", ERuntimeType::String, sizeof(RuntimeVar::data.str));
-	type->SetNativeCtor([](RuntimeVar* var, ByteStream& stream) {
-		std::string str = stream.Read<std::string>();
-		var->data.str.size = str.size();
-		var->data.str.ptr = new char[str.size() + 1];
-		memcpy(var->data.str.ptr, str.c_str(), var->data.str.size);
-		var->data.str.ptr[var->data.str.size] = 0;
+	type->SetStringCtor([](RuntimeVar* var, const char* ptr, size_t size) {
+		var->data.str.size = size;
+		var->data.str.ptr = new char[size + 1];
+		ChargeVarBytes(var, size + 1);
+		if (ptr)
+			memcpy(var->data.str.ptr, ptr, size);
+		var->data.str.ptr[size] = 0;
+	});
+	type->SetNativeLen([](RuntimeVar* var) -> int64_t {
+		return var->data.str.size;
+	});
+	type->SetNativeCopy([](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* dst, RuntimeVar* src) {
+		dst->ConstructString(src->data.str.ptr, src->data.str.size);
 	});
 	type->SetNativeTypeConvert([](RuntimeVar* var, RuntimeType* type) -> bool {
 
 		if (type->GetTypeEnum() == ERuntimeType::Null) { // String -> Null
 			if (var->data.str.ptr) {
 				delete[] var->data.str.ptr;
+				ChargeVarBytes(var, -(ptrdiff_t)(var->data.str.size + 1));
 				var->data.str.ptr = 0;
 			}
 			var->data.str.size = 0;
@@ -366,11 +361,12 @@ RuntimeType* Precompile::Type_String() {
 	type->SetOperator(ERuntimeCallType::Add, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
 		ERuntimeType targetType = p2->GetType()->GetTypeEnum();
 		if (targetType == ERuntimeType::String) {
+			if (!exec->ReserveBytes(p1->data.str.size + p2->data.str.size + 1))
+				return nullptr;
 			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::String));
-			std::string s = std::string(p1->data.str.ptr, p1->data.str.ptr + p1->data.str.size) + std::string(p2->data.str.ptr, p2->data.str.ptr + p2->data.str.size);
-			ByteStream stream;
-			stream.Write(s);
-			ret->GetType()->NativeCtor(ret, stream);
+			ret->ConstructString(nullptr, p1->data.str.size + p2->data.str.size);
+			std::copy_n(p1->data.str.ptr, p1->data.str.size, ret->data.str.ptr);
+			std::copy_n(p2->data.str.ptr, p2->data.str.size, ret->data.str.ptr + p1->data.str.size);
 			return ret;
 		}
 		exec->SetError("Illegal operation: " + p1->GetType()->GetName() + " + " + p2->GetType()->GetName());
@@ -387,16 +383,7 @@ RuntimeType* Precompile::Type_String() {
 				exec->SetError("Illegal operation: " + p1->GetType()->GetName() + " * " + p2->GetType()->GetName() + ", int should be positive");
 				return nullptr;
 			}
-			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::String));
-			std::string s;
-			std::string cp = std::string(p1->data.str.ptr, p1->data.str.ptr + p1->data.str.size);
-			for (int64_t i = 0; i < p2->data.i64; ++i) {
-				s += cp;
-			}
-			ByteStream stream;
-			stream.Write(s);
-			ret->GetType()->NativeCtor(ret, stream);
-			return ret;
+			return RepeatString(ctx, exec, p1, p2->data.i64);
 		}
 		exec->SetError("Illegal operation: " + p1->GetType()->GetName() + " * " + p2->GetType()->GetName());
 		return nullptr;
@@ -421,27 +408,19 @@ RuntimeType* Precompile::Type_String() {
 
 	type->SetOperator(ERuntimeCallType::CompareEq, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
 		ERuntimeType targetType = p2->GetType()->GetTypeEnum();
-		RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-		ret->data.i64 = 0;
+		bool eq = false;
 		if (targetType == ERuntimeType::String) {
-			ret->data.i64 = p1->data.str.size == p2->data.str.size && (p1->data.str.ptr == p2->data.str.ptr || !memcmp(p1->data.str.ptr, p2->data.str.ptr, p1->data.str.size));
+			eq = p1->data.str.size == p2->data.str.size && (p1->data.str.ptr == p2->data.str.ptr || !memcmp(p1->data.str.ptr, p2->data.str.ptr, p1->data.str.size));
 		}
-		return ret;
+		return exec->CreateInt64(ctx, eq);
 	});
 	type->SetOperator(ERuntimeCallType::CompareLess, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
 		ERuntimeType targetType = p2->GetType()->GetTypeEnum();
 		if (targetType == ERuntimeType::String) {
-			RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-			if (!p1->data.str.ptr || !p2->data.str.ptr) {
-				ret->data.i64 = 0;
-			}
-			else if(p1->data.str.size < p2->data.str.size) {
-				ret->data.i64 = 1;
-			}
-			else {
-				ret->data.i64 = memcmp(p1->data.str.ptr, p2->data.str.ptr, p1->data.str.size) > 0;
-			}
-			return ret;
+			// lexicographic by bytes, a prefix before the longer string; a strict order, which SortedMap relies on
+			size_t common = std::min(p1->data.str.size, p2->data.str.size);
+			int cmp = common ? memcmp(p1->data.str.ptr, p2->data.str.ptr, common) : 0;
+			return exec->CreateInt64(ctx, cmp < 0 || (cmp == 0 && p1->data.str.size < p2->data.str.size));
 		}
 		exec->SetError("Illegal operation: " + p1->GetType()->GetName() + " < " + p2->GetType()->GetName());
 		return nullptr;
@@ -455,7 +434,8 @@ RuntimeType* Precompile::Type_Array() {
 	type->SetNativeTypeConvert([](RuntimeVar* var, RuntimeType* type) -> bool {
         if(type->GetTypeEnum() == ERuntimeType::Null){
             if(var->data.arr.data){
-                delete var->data.arr.data;
+                delete[] var->data.arr.data;
+                ChargeVarBytes(var, -(ptrdiff_t)(var->data.arr.cap * sizeof(RuntimeVar*)));
                 var->data.arr.data = 0;
             }
             var->data.arr.size = var->data.arr.cap = 0;
@@ -463,12 +443,25 @@ RuntimeType* Precompile::Type_Array() {
         }
 		return false;
 	});
-    type->SetNativeCtor([](RuntimeVar* var, ByteStream& stream) {
-        int64_t cap = stream.Read<int64_t>();
-        cap = std::max(1ll, cap);
+    // the int constructor takes the initial capacity
+    type->SetIntCtor([](RuntimeVar* var, int64_t cap) {
+        cap = std::max((int64_t)1, cap);
         var->data.arr.size = 0;
         var->data.arr.data = new RuntimeVar*[cap];
         var->data.arr.cap = cap;
+        ChargeVarBytes(var, cap * sizeof(RuntimeVar*));
+    });
+    type->SetNativeLen([](RuntimeVar* var) -> int64_t {
+        return var->data.arr.size;
+    });
+    type->SetNativeCopy([](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* dst, RuntimeVar* src) {
+        dst->ConstructInt(src->data.arr.cap);
+        for (size_t i = 0; i < src->data.arr.size; ++i) {
+            RuntimeVar* cp = exec->CreateVar(ctx);
+            cp->CopyFrom(ctx, exec, src->data.arr.data[i]);
+            dst->data.arr.data[i] = cp;
+        }
+        dst->data.arr.size = src->data.arr.size;
     });
 
     type->SetOperator(ERuntimeCallType::ArrayAppend, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
@@ -482,13 +475,18 @@ RuntimeType* Precompile::Type_Array() {
 
         if(size >= cap){
             uint32_t newCap = cap * 2;
+            if (!exec->ReserveBytes((newCap - cap) * sizeof(RuntimeVar*)))
+                return nullptr;
             auto newData = new RuntimeVar*[newCap];
             std::copy(p1->data.arr.data, p1->data.arr.data + size, newData);
             auto oldData = std::exchange(p1->data.arr.data, newData);
             delete[] oldData;
+            ChargeVarBytes(p1, (newCap - cap) * sizeof(RuntimeVar*));
             cap = newCap;
         }
-        p1->data.arr.data[size++] = p2;
+        RuntimeVar* elem = exec->CreateVar(ctx);
+        elem->CopyFrom(ctx, exec, p2);
+        p1->data.arr.data[size++] = elem;
 
         return nullptr;
     });
@@ -502,30 +500,555 @@ RuntimeType* Precompile::Type_Array() {
         uint32_t& size = p1->data.arr.size;
         if(p2->data.i64 >= size || p2->data.i64 < 0){
             exec->SetError("Illegal operation: Invalid array access " + std::to_string(p2->data.i64) + " for [0;" + std::to_string(size) + ")");
-            return p1->data.arr.data[p2->data.i64];;
+            return nullptr;
         }
 
         return p1->data.arr.data[p2->data.i64];
     });
 
     type->SetOperator(ERuntimeCallType::ArraySize, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
-        RuntimeVar* ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-        ByteStream stream;
-        stream.Write<int64_t>(p1->data.arr.size);
-        ret->GetType()->NativeCtor(ret, stream);
-        return ret;
+        return exec->CreateInt64(ctx, p1->data.arr.size);
     });
 	return type;
 }
 
+RuntimeType* Precompile::Type_Range() {
+	RuntimeType* type = new RuntimeType("Range", ERuntimeType::Range, sizeof(RuntimeVar::data.custom));
+
+	type->SetNativeTypeConvert([](RuntimeVar* var, RuntimeType* type) -> bool {
+		RuntimeRange* range = static_cast<RuntimeRange*>(var->data.custom.dataBlob);
+		if (type->GetTypeEnum() == ERuntimeType::Null) { // Range -> Null
+			if (range)
+				ChargeVarBytes(var, -(ptrdiff_t)sizeof(RuntimeRange));
+			delete range;
+			var->data.custom.dataBlob = nullptr;
+			return true;
+		}
+		else if (type->GetTypeEnum() == ERuntimeType::String) { // Range -> String
+			char buf[80];
+			int len = snprintf(buf, sizeof(buf), "range(%lld, %lld, %lld)", (long long)range->start, (long long)range->stop, (long long)range->step);
+			delete range;
+			ChargeVarBytes(var, -(ptrdiff_t)sizeof(RuntimeRange));
+			type->ConstructString(var, buf, len);
+			return true;
+		}
+		return false;
+	});
+	type->SetNativeIsFalse([](RuntimeVar* var) -> bool {
+		return static_cast<RuntimeRange*>(var->data.custom.dataBlob)->Size() == 0;
+	});
+	type->SetNativeLen([](RuntimeVar* var) -> int64_t {
+		return static_cast<RuntimeRange*>(var->data.custom.dataBlob)->Size();
+	});
+	type->SetNativeCopy([](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* dst, RuntimeVar* src) {
+		dst->data.custom.dataBlob = new RuntimeRange(*static_cast<RuntimeRange*>(src->data.custom.dataBlob));
+		ChargeVarBytes(dst, sizeof(RuntimeRange));
+	});
+
+	type->SetOperator(ERuntimeCallType::ArrayAccess, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
+		if (p2->GetType()->GetTypeEnum() != ERuntimeType::Int64) {
+			exec->SetError("Illegal operation: Index is not Int64: " + p2->GetType()->GetName());
+			return nullptr;
+		}
+		const RuntimeRange* range = static_cast<RuntimeRange*>(p1->data.custom.dataBlob);
+		int64_t size = range->Size();
+		if (p2->data.i64 >= size || p2->data.i64 < 0) {
+			exec->SetError("Illegal operation: Invalid range access " + std::to_string(p2->data.i64) + " for [0;" + std::to_string(size) + ")");
+			return nullptr;
+		}
+		return exec->CreateInt64(ctx, range->At(p2->data.i64));
+	});
+
+	type->SetOperator(ERuntimeCallType::ArraySize, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
+		return exec->CreateInt64(ctx, static_cast<RuntimeRange*>(p1->data.custom.dataBlob)->Size());
+	});
+	return type;
+}
+
+template<typename T>
+RuntimeType* Precompile::Type_Container(ERuntimeType typeEnum) {
+	RuntimeType* type = new RuntimeType(ERuntimeType_ToString(typeEnum), typeEnum, sizeof(RuntimeVar::data.custom));
+
+	// elements left behind are collected like the elements of a dropped array
+	type->SetNativeTypeConvert([](RuntimeVar* var, RuntimeType* type) -> bool {
+		if (type->GetTypeEnum() == ERuntimeType::Null) {
+			T* blob = static_cast<T*>(var->data.custom.dataBlob);
+			if (blob)
+				ChargeVarBytes(var, -(ptrdiff_t)blob->GetBytes());
+			delete blob;
+			var->data.custom.dataBlob = nullptr;
+			return true;
+		}
+		return false;
+	});
+	type->SetNativeIsFalse([](RuntimeVar* var) -> bool {
+		return static_cast<T*>(var->data.custom.dataBlob)->Size() == 0;
+	});
+	type->SetNativeLen([](RuntimeVar* var) -> int64_t {
+		return static_cast<T*>(var->data.custom.dataBlob)->Size();
+	});
+	return type;
+}
+
+RuntimeType* Precompile::Type_Dict() {
+	RuntimeType* type = Type_Container<RuntimeDict>(ERuntimeType::Dict);
+	// keys keep their cached hashes, nothing is rehashed
+	type->SetNativeCopy([](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* dst, RuntimeVar* src) {
+		const RuntimeDict* from = static_cast<RuntimeDict*>(src->data.custom.dataBlob);
+		RuntimeDict* dict = new RuntimeDict();
+		dict->Reserve(from->Size());
+		for (size_t i = 0; i < from->Size(); ++i) {
+			const RuntimeDict::Entry& entry = from->At(i);
+			RuntimeVar* key = exec->CreateVar(ctx);
+			key->CopyFrom(ctx, exec, entry.key);
+			RuntimeVar* value = exec->CreateVar(ctx);
+			value->CopyFrom(ctx, exec, entry.value);
+			dict->Insert({ entry.hash, key, value });
+		}
+		dst->data.custom.dataBlob = dict;
+		ChargeVarBytes(dst, dict->GetBytes());
+	});
+
+	// d[i] is the i-th key in iteration order, which is what for-in walks through
+	type->SetOperator(ERuntimeCallType::ArrayAccess, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
+		if (p2->GetType()->GetTypeEnum() != ERuntimeType::Int64) {
+			exec->SetError("Illegal operation: Index is not Int64: " + p2->GetType()->GetName());
+			return nullptr;
+		}
+		const RuntimeDict* dict = static_cast<RuntimeDict*>(p1->data.custom.dataBlob);
+		if (p2->data.i64 >= (int64_t)dict->Size() || p2->data.i64 < 0) {
+			exec->SetError("Illegal operation: Invalid dict access " + std::to_string(p2->data.i64) + " for [0;" + std::to_string(dict->Size()) + ")");
+			return nullptr;
+		}
+		RuntimeVar* key = exec->CreateVar(ctx);
+		key->CopyFrom(ctx, exec, dict->At(p2->data.i64).key);
+		return key;
+	});
+
+	type->SetOperator(ERuntimeCallType::ArraySize, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
+		return exec->CreateInt64(ctx, static_cast<RuntimeDict*>(p1->data.custom.dataBlob)->Size());
+	});
+	return type;
+}
+
+RuntimeType* Precompile::Type_Bitset() {
+	RuntimeType* type = Type_Container<RuntimeBitset>(ERuntimeType::Bitset);
+	type->SetNativeCopy([](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* dst, RuntimeVar* src) {
+		RuntimeBitset* bits = new RuntimeBitset(*static_cast<RuntimeBitset*>(src->data.custom.dataBlob));
+		dst->data.custom.dataBlob = bits;
+		ChargeVarBytes(dst, bits->GetBytes());
+	});
+
+	// b[i] reads bit i as 0 or 1, so for-in walks the flags
+	type->SetOperator(ERuntimeCallType::ArrayAccess, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
+		if (p2->GetType()->GetTypeEnum() != ERuntimeType::Int64) {
+			exec->SetError("Illegal operation: Index is not Int64: " + p2->GetType()->GetName());
+			return nullptr;
+		}
+		const RuntimeBitset* bits = static_cast<RuntimeBitset*>(p1->data.custom.dataBlob);
+		if (p2->data.i64 >= (int64_t)bits->Size() || p2->data.i64 < 0) {
+			exec->SetError("Illegal operation: Invalid bitset access " + std::to_string(p2->data.i64) + " for [0;" + std::to_string(bits->Size()) + ")");
+			return nullptr;
+		}
+		return exec->CreateInt64(ctx, bits->Test(p2->data.i64));
+	});
+
+	type->SetOperator(ERuntimeCallType::ArraySize, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
+		return exec->CreateInt64(ctx, static_cast<RuntimeBitset*>(p1->data.custom.dataBlob)->Size());
+	});
+	return type;
+}
+
+RuntimeType* Precompile::Type_Heap() {
+	RuntimeType* type = Type_Container<RuntimeHeap>(ERuntimeType::Heap);
+	// items keep their places, which keeps the heap order without comparing anything
+	type->SetNativeCopy([](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* dst, RuntimeVar* src) {
+		const RuntimeHeap* from = static_cast<RuntimeHeap*>(src->data.custom.dataBlob);
+		RuntimeHeap* heap = new RuntimeHeap(from->IsKeyed());
+		heap->Reserve(from->Size());
+		for (size_t i = 0; i < from->Size(); ++i) {
+			RuntimeVar* value = exec->CreateVar(ctx);
+			value->CopyFrom(ctx, exec, from->At(i).value);
+			heap->Append({ from->IsKeyed() ? value->data.arr.data[0] : value, value });
+		}
+		dst->data.custom.dataBlob = heap;
+		ChargeVarBytes(dst, heap->GetBytes());
+	});
+	return type;
+}
+
+RuntimeType* Precompile::Type_Deque() {
+	RuntimeType* type = Type_Container<RuntimeDeque>(ERuntimeType::Deque);
+	type->SetNativeCopy([](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* dst, RuntimeVar* src) {
+		const RuntimeDeque* from = static_cast<RuntimeDeque*>(src->data.custom.dataBlob);
+		RuntimeDeque* deque = new RuntimeDeque();
+		deque->Reserve(from->Size());
+		for (size_t i = 0; i < from->Size(); ++i) {
+			RuntimeVar* elem = exec->CreateVar(ctx);
+			elem->CopyFrom(ctx, exec, from->At(i));
+			deque->PushBack(elem);
+		}
+		dst->data.custom.dataBlob = deque;
+		ChargeVarBytes(dst, deque->GetBytes());
+	});
+
+	// q[i] is a copy of the i-th element from the front, so for-in walks front to back
+	type->SetOperator(ERuntimeCallType::ArrayAccess, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
+		if (p2->GetType()->GetTypeEnum() != ERuntimeType::Int64) {
+			exec->SetError("Illegal operation: Index is not Int64: " + p2->GetType()->GetName());
+			return nullptr;
+		}
+		const RuntimeDeque* deque = static_cast<RuntimeDeque*>(p1->data.custom.dataBlob);
+		if (p2->data.i64 >= (int64_t)deque->Size() || p2->data.i64 < 0) {
+			exec->SetError("Illegal operation: Invalid deque access " + std::to_string(p2->data.i64) + " for [0;" + std::to_string(deque->Size()) + ")");
+			return nullptr;
+		}
+		RuntimeVar* elem = exec->CreateVar(ctx);
+		elem->CopyFrom(ctx, exec, deque->At(p2->data.i64));
+		return elem;
+	});
+
+	type->SetOperator(ERuntimeCallType::ArraySize, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
+		return exec->CreateInt64(ctx, static_cast<RuntimeDeque*>(p1->data.custom.dataBlob)->Size());
+	});
+	return type;
+}
+
+RuntimeType* Precompile::Type_SortedMap() {
+	RuntimeType* type = Type_Container<RuntimeSortedMap>(ERuntimeType::SortedMap);
+	// entries arrive in key order, so the copy is built without comparing keys
+	type->SetNativeCopy([](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* dst, RuntimeVar* src) {
+		RuntimeSortedMap* map = new RuntimeSortedMap();
+		static_cast<RuntimeSortedMap*>(src->data.custom.dataBlob)->ForEach([&](RuntimeVar* key, RuntimeVar* value) {
+			RuntimeVar* keyCopy = exec->CreateVar(ctx);
+			keyCopy->CopyFrom(ctx, exec, key);
+			RuntimeVar* valueCopy = exec->CreateVar(ctx);
+			valueCopy->CopyFrom(ctx, exec, value);
+			map->Append(keyCopy, valueCopy);
+		});
+		dst->data.custom.dataBlob = map;
+		ChargeVarBytes(dst, map->GetBytes());
+	});
+
+	// m[i] is the key of rank i, so for-in walks the keys in order and lowerbound/upperbound ranks index a key range
+	type->SetOperator(ERuntimeCallType::ArrayAccess, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
+		if (p2->GetType()->GetTypeEnum() != ERuntimeType::Int64) {
+			exec->SetError("Illegal operation: Index is not Int64: " + p2->GetType()->GetName());
+			return nullptr;
+		}
+		const RuntimeSortedMap* map = static_cast<RuntimeSortedMap*>(p1->data.custom.dataBlob);
+		if (p2->data.i64 >= (int64_t)map->Size() || p2->data.i64 < 0) {
+			exec->SetError("Illegal operation: Invalid sorted map access " + std::to_string(p2->data.i64) + " for [0;" + std::to_string(map->Size()) + ")");
+			return nullptr;
+		}
+		RuntimeVar* key = exec->CreateVar(ctx);
+		key->CopyFrom(ctx, exec, map->At(p2->data.i64).key);
+		return key;
+	});
+
+	type->SetOperator(ERuntimeCallType::ArraySize, [](RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2) -> RuntimeVar* {
+		return exec->CreateInt64(ctx, static_cast<RuntimeSortedMap*>(p1->data.custom.dataBlob)->Size());
+	});
+	return type;
+}
+
+int64_t Precompile::Native_Int(RuntimeCtx* ctx, RuntimeExecutor* exec, std::string_view str) {
+    try {
+        return std::stoll(std::string(str));
+    }
+    catch (...) {
+        exec->SetError("Failed to convert to int");
+        return 0;
+    }
+}
+
+void Precompile::Native_Append(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeArrayView array, RuntimeVar* item) {
+    array.var->CallOperator(ERuntimeCallType::ArrayAppend, ctx, exec, item);
+}
+
+int64_t Precompile::Native_Len(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* value) {
+    if (value->GetType()->HasLen())
+        return value->GetType()->Len(value);
+    exec->SetError("Failed to len(), invalid type " + value->GetType()->GetName() + ", it has no length");
+    return 0;
+}
+
+bool Precompile::DictKey(RuntimeExecutor* exec, const char* method, RuntimeVar* key, uint64_t& hash) {
+    if (RuntimeDict::Hash(key, hash))
+        return true;
+    exec->SetError(std::string(method) + ": key should be Int64 or String, got " + key->GetType()->GetName());
+    return false;
+}
+
+bool Precompile::SortedKey(RuntimeExecutor* exec, const char* method, RuntimeVar* key) {
+    if (key->GetType()->HasOperator(ERuntimeCallType::CompareLess))
+        return true;
+    exec->SetError(std::string(method) + ": key should be comparable with <, got " + key->GetType()->GetName());
+    return false;
+}
+
+RuntimeVar** Precompile::FindValue(RuntimeCtx* ctx, RuntimeExecutor* exec, const char* method, RuntimeMapView map, RuntimeVar* key, uint64_t& hash) {
+    if (map.IsSorted()) {
+        if (!SortedKey(exec, method, key))
+            return nullptr;
+        return map.Sorted()->Find(key, RuntimeKeyOrder{ ctx, exec });
+    }
+    if (!DictKey(exec, method, key, hash))
+        return nullptr;
+    int64_t idx = map.Dict()->Find(key, hash);
+    return idx < 0 ? nullptr : &map.Dict()->At(idx).value;
+}
+
+RuntimeVar* Precompile::Native_Get(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeMapView map, RuntimeVar* key) {
+    uint64_t hash;
+    RuntimeVar** slot = FindValue(ctx, exec, "get", map, key, hash);
+    if (!slot) {
+        if (!exec->IsErrored())
+            exec->SetError("get: key not found");
+        return nullptr;
+    }
+    RuntimeVar* value = exec->CreateVar(ctx);
+    value->CopyFrom(ctx, exec, *slot);
+    return value;
+}
+
+void Precompile::Native_Set(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeMapView map, RuntimeVar* key, RuntimeVar* value) {
+    // like array elements, maps hold copies, made only for a key the map does not have yet
+    auto copies = [&]() {
+        RuntimeVar* keyCopy = exec->CreateVar(ctx);
+        keyCopy->CopyFrom(ctx, exec, key);
+        RuntimeVar* valueCopy = exec->CreateVar(ctx);
+        valueCopy->CopyFrom(ctx, exec, value);
+        return RuntimeSortedMap::Entry{ keyCopy, valueCopy };
+    };
+    RuntimeVar** slot;
+    if (map.IsSorted()) {
+        if (!SortedKey(exec, "set", key))
+            return;
+        size_t bytes = map.Sorted()->GetBytes();
+        if (!map.Sorted()->Assign(key, RuntimeKeyOrder{ ctx, exec }, slot, copies)) {
+            if (!exec->IsErrored())
+                exec->SetError("set: key comparison failed");
+            return;
+        }
+        ChargeVarBytes(map.var, map.Sorted()->GetBytes() - bytes);
+    }
+    else {
+        uint64_t hash;
+        if (!DictKey(exec, "set", key, hash))
+            return;
+        int64_t idx = map.Dict()->Find(key, hash);
+        slot = idx < 0 ? nullptr : &map.Dict()->At(idx).value;
+        if (!slot) {
+            RuntimeSortedMap::Entry entry = copies();
+            size_t bytes = map.Dict()->GetBytes();
+            map.Dict()->Insert({ hash, entry.key, entry.value });
+            ChargeVarBytes(map.var, map.Dict()->GetBytes() - bytes);
+        }
+    }
+    if (slot) {
+        RuntimeVar* old = *slot;
+        old->NativeTypeConvert(ctx->GetType(ERuntimeType::Null));
+        old->CopyFrom(ctx, exec, value);
+    }
+}
+
+int64_t Precompile::Native_Has(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeMapView map, RuntimeVar* key) {
+    uint64_t hash;
+    return FindValue(ctx, exec, "has", map, key, hash) != nullptr;
+}
+
+int64_t Precompile::Native_Remove(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeMapView map, RuntimeVar* key) {
+    RuntimeVar* removedKey;
+    RuntimeVar* removedValue;
+    if (map.IsSorted()) {
+        RuntimeSortedMap::Entry removed;
+        size_t bytes = map.Sorted()->GetBytes();
+        if (!SortedKey(exec, "remove", key) || !map.Sorted()->Remove(key, RuntimeKeyOrder{ ctx, exec }, removed))
+            return 0;
+        // merged nodes are freed right away
+        ChargeVarBytes(map.var, (ptrdiff_t)map.Sorted()->GetBytes() - (ptrdiff_t)bytes);
+        removedKey = removed.key;
+        removedValue = removed.value;
+    }
+    else {
+        uint64_t hash;
+        RuntimeDict::Entry removed;
+        if (!DictKey(exec, "remove", key, hash) || !map.Dict()->Remove(key, hash, removed))
+            return 0;
+        removedKey = removed.key;
+        removedValue = removed.value;
+    }
+    // nothing else refers to them: get and positional access hand out copies
+    exec->ReturnVar(ctx, removedKey);
+    exec->ReturnVar(ctx, removedValue);
+    return 1;
+}
+
+bool Precompile::Less(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* a, RuntimeVar* b) {
+    ERuntimeType typeA = a->GetType()->GetTypeEnum();
+    ERuntimeType typeB = b->GetType()->GetTypeEnum();
+    if (typeA == ERuntimeType::Int64 && typeB == ERuntimeType::Int64)
+        return a->data.i64 < b->data.i64;
+    if (typeA == ERuntimeType::Double && typeB == ERuntimeType::Double)
+        return a->data.dbl < b->data.dbl;
+    if (exec->IsErrored())
+        return false;
+    if (!a->GetType()->HasOperator(ERuntimeCallType::CompareLess)) {
+        exec->SetError("Illegal operation: " + a->GetType()->GetName() + " < " + b->GetType()->GetName());
+        return false;
+    }
+    RuntimeVar* ret = a->CallOperator(ERuntimeCallType::CompareLess, ctx, exec, b);
+    if (!ret)
+        return false;
+    bool less = ret->data.i64 != 0;
+    exec->ReturnVar(ctx, ret);
+    return less;
+}
+
+void Precompile::Native_Push(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeHeapView heap, RuntimeVar* value) {
+    if (heap->IsKeyed() && (value->GetType()->GetTypeEnum() != ERuntimeType::Array || value->data.arr.size == 0)) {
+        exec->SetError("push: keyed heap expects [priority, payload] arrays, got " + value->GetType()->GetName());
+        return;
+    }
+    // like array elements, the heap holds copies
+    RuntimeVar* copy = exec->CreateVar(ctx);
+    copy->CopyFrom(ctx, exec, value);
+    RuntimeVar* key = heap->IsKeyed() ? copy->data.arr.data[0] : copy;
+    size_t bytes = heap->GetBytes();
+    heap->Push({ key, copy }, [ctx, exec](RuntimeVar* a, RuntimeVar* b) { return Less(ctx, exec, a, b); });
+    ChargeVarBytes(heap.var, heap->GetBytes() - bytes);
+}
+
+RuntimeVar* Precompile::Native_Pop(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeHeapView heap) {
+    if (heap->Size() == 0) {
+        exec->SetError("pop: heap is empty");
+        return nullptr;
+    }
+    // nothing else refers to the value: peek hands out copies
+    return heap->Pop([ctx, exec](RuntimeVar* a, RuntimeVar* b) { return Less(ctx, exec, a, b); }).value;
+}
+
+RuntimeVar* Precompile::Native_Peek(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeHeapView heap) {
+    if (heap->Size() == 0) {
+        exec->SetError("peek: heap is empty");
+        return nullptr;
+    }
+    RuntimeVar* value = exec->CreateVar(ctx);
+    value->CopyFrom(ctx, exec, heap->Top().value);
+    return value;
+}
+
+RuntimeVar* Precompile::Native_Deque(RuntimeCtx* ctx, RuntimeExecutor* exec) {
+    RuntimeVar* var = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Deque));
+    RuntimeDeque* deque = new RuntimeDeque();
+    var->data.custom.dataBlob = deque;
+    ChargeVarBytes(var, deque->GetBytes());
+    return var;
+}
+
+template<bool front>
+void Precompile::Native_DequePush(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeDequeView deque, RuntimeVar* value) {
+    if (deque->IsFull()) {
+        size_t bytes = deque->GrowBytes();
+        if (!exec->ReserveBytes(bytes))
+            return;
+        deque->Grow();
+        ChargeVarBytes(deque.var, bytes);
+    }
+    // like array elements, the deque holds copies
+    RuntimeVar* elem = exec->CreateVar(ctx);
+    elem->CopyFrom(ctx, exec, value);
+    if constexpr (front)
+        deque->PushFront(elem);
+    else
+        deque->PushBack(elem);
+}
+
+template<bool front>
+RuntimeVar* Precompile::Native_DequePop(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeDequeView deque) {
+    if (deque->Size() == 0) {
+        exec->SetError(std::string(front ? "popfront" : "popback") + ": deque is empty");
+        return nullptr;
+    }
+    // nothing else refers to the element: positional access hands out copies
+    if constexpr (front)
+        return deque->PopFront();
+    else
+        return deque->PopBack();
+}
+
+template<bool lower>
+int64_t Precompile::Native_Bound(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeSortedMapView map, RuntimeVar* key) {
+    const char* method = lower ? "lowerbound" : "upperbound";
+    if (!SortedKey(exec, method, key))
+        return 0;
+    RuntimeKeyOrder order{ ctx, exec };
+    return lower ? map->LowerBound(key, order) : map->UpperBound(key, order);
+}
+
+bool Precompile::BitIndex(RuntimeExecutor* exec, const char* method, RuntimeBitsetView bits, int64_t idx) {
+    if (idx >= 0 && idx < (int64_t)bits->Size())
+        return true;
+    exec->SetError(std::string(method) + ": bit " + std::to_string(idx) + " out of [0;" + std::to_string(bits->Size()) + ")");
+    return false;
+}
+
+RuntimeVar* Precompile::Native_Bitset(RuntimeCtx* ctx, RuntimeExecutor* exec, int64_t size) {
+    if (size < 0) {
+        exec->SetError("bitset: size should not be negative, got " + std::to_string(size));
+        return nullptr;
+    }
+    if (!exec->ReserveBytes(size / 8))
+        return nullptr;
+    RuntimeVar* var = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Bitset));
+    RuntimeBitset* bits = new RuntimeBitset(size);
+    var->data.custom.dataBlob = bits;
+    ChargeVarBytes(var, bits->GetBytes());
+    return var;
+}
+
+void Precompile::Native_SetBit(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeBitsetView bits, int64_t idx) {
+    if (BitIndex(exec, "setbit", bits, idx))
+        bits->Set(idx);
+}
+
+void Precompile::Native_ClearBit(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeBitsetView bits, int64_t idx) {
+    if (BitIndex(exec, "clearbit", bits, idx))
+        bits->Clear(idx);
+}
+
+int64_t Precompile::Native_TestBit(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeBitsetView bits, int64_t idx) {
+    return BitIndex(exec, "testbit", bits, idx) && bits->Test(idx);
+}
+
+int64_t Precompile::Native_Popcount(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeBitsetView bits) {
+    return bits->Count();
+}
+
+template<void (RuntimeBitset::*Op)(const RuntimeBitset&)>
+void Precompile::Native_BitOp(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeBitsetView dst, RuntimeBitsetView src) {
+    if (dst->Size() != src->Size()) {
+        exec->SetError("Bitsets differ in size: " + std::to_string(dst->Size()) + " and " + std::to_string(src->Size()));
+        return;
+    }
+    ((*dst).*Op)(*src);
+}
+
+void Precompile::AddNative(RuntimeCtx* ctx, RuntimeMethod* method, ENativeEffect effect) {
+    method->SetPure(effect != ENativeEffect::External);
+    method->SetWritesArgs(effect == ENativeEffect::WritesArgs);
+    ctx->AddMethod(method);
+}
+
 void Precompile::AddReservedMethods(RuntimeCtx* ctx) {
-    ctx->AddMethod(new RuntimeMethod("print", [](RuntimeCtx *ctx, RuntimeExecutor *exec,
-                                                 const std::vector<RuntimeVar *> &params) -> RuntimeVar * {
+    AddNative(ctx, new RuntimeMethod("print", [](RuntimeCtx *ctx, RuntimeExecutor *exec,
+                                                 RuntimeArgs params) -> RuntimeVar * {
         printf("[Script] ");
         int arg = 1;
         for (auto &param: params) {
             RuntimeVar *str = exec->CreateVar(ctx);
-            str->CopyFrom(ctx, ctx->GetExecutor(), param);
+            str->CopyFrom(ctx, exec, param);
             if (param->GetType()->GetTypeEnum() == ERuntimeType::Null ||
                 !str->NativeTypeConvert(ctx->GetType(ERuntimeType::String))) {
                 exec->SetError("print: Invalid argument " + std::to_string(arg) + ", not string");
@@ -537,69 +1060,133 @@ void Precompile::AddReservedMethods(RuntimeCtx* ctx) {
         }
         printf("\n");
         return exec->CreateVar(ctx);
-    }));
+    }), ENativeEffect::External);
 
-    ctx->AddMethod(new RuntimeMethod("read", [](RuntimeCtx *ctx, RuntimeExecutor *exec,
-                                                const std::vector<RuntimeVar *> &params) -> RuntimeVar * {
+    AddNative(ctx, new RuntimeMethod("read", [](RuntimeCtx *ctx, RuntimeExecutor *exec,
+                                                RuntimeArgs params) -> RuntimeVar * {
         std::string str;
         std::cin >> str;
         RuntimeVar *var = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::String));
-        ByteStream stream;
-        stream.Write(str);
-        var->NativeCtor(stream);
+        var->ConstructString(str.data(), str.size());
         return var;
-    }));
+    }), ENativeEffect::External);
+
+    AddNative(ctx, MakeNative<&Native_Int>("int"), ENativeEffect::None);
+    AddNative(ctx, MakeNative<&Native_Append>("append"), ENativeEffect::WritesArgs);
+    AddNative(ctx, MakeNative<&Native_Len>("len"), ENativeEffect::None);
 
-    ctx->AddMethod(new RuntimeMethod("int", {"i"}, [](RuntimeCtx *ctx, RuntimeExecutor *exec,
-                                               const std::vector<RuntimeVar *> &params) -> RuntimeVar * {
-        if (params[0]->GetType()->GetTypeEnum() != ERuntimeType::String) {
-            exec->SetError("Failed to convert to int");
+    AddNative(ctx, new RuntimeMethod("range", [](RuntimeCtx *ctx, RuntimeExecutor *exec,
+                                                 RuntimeArgs params) -> RuntimeVar * {
+        if (params.empty() || params.size() > 3) {
+            exec->SetError("range() takes 1 to 3 arguments, got " + std::to_string(params.size()));
             return 0;
         }
-        std::string str = params[0]->data.str.ptr;
-
-        ByteStream stream;
-        try {
-            stream.Write(std::stoll(str));
+        for (size_t i = 0; i < params.size(); ++i) {
+            if (params[i]->GetType()->GetTypeEnum() != ERuntimeType::Int64) {
+                exec->SetError("range(): argument " + std::to_string(i + 1) + " should be Int64, got " + params[i]->GetType()->GetName());
+                return 0;
+            }
         }
-        catch (...) {
-            exec->SetError("Failed to convert to int");
+        int64_t start = params.size() > 1 ? params[0]->data.i64 : 0;
+        int64_t stop = params.size() > 1 ? params[1]->data.i64 : params[0]->data.i64;
+        int64_t step = params.size() > 2 ? params[2]->data.i64 : 1;
+        if (step == 0) {
+            exec->SetError("range(): step should not be zero");
             return 0;
         }
-        RuntimeVar *var = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-        var->NativeCtor(stream);
-        return var;
-    }));
+        RuntimeRange range{ start, stop, step };
+        constexpr int64_t maxSize = std::numeric_limits<int64_t>::max();
+        if (range.Count() > (uint64_t)maxSize) {
+            exec->SetError("range(): more than " + std::to_string(maxSize) + " elements");
+            return 0;
+        }
+        auto ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Range));
+        ret->data.custom.dataBlob = new RuntimeRange(range);
+        ChargeVarBytes(ret, sizeof(RuntimeRange));
+        return ret;
+    }), ENativeEffect::None);
 
-    ctx->AddMethod(new RuntimeMethod("append", {"a", "i"}, [](RuntimeCtx *ctx, RuntimeExecutor *exec,
-                                                      const std::vector<RuntimeVar *> &params) -> RuntimeVar * {
-        if (params[0]->GetType()->GetTypeEnum() != ERuntimeType::Array) {
-            exec->SetError("Failed to append, first argument should be array");
+    // dict(k1, v1, k2, v2, ...), what the literal {k1: v1, k2: v2, ...} lowers to; later keys win
+    AddNative(ctx, new RuntimeMethod("dict", [](RuntimeCtx *ctx, RuntimeExecutor *exec,
+                                                RuntimeArgs params) -> RuntimeVar * {
+        if (params.size() % 2) {
+            exec->SetError("dict() takes key, value pairs, got " + std::to_string(params.size()) + " arguments");
             return 0;
         }
-        params[0]->CallOperator(ERuntimeCallType::ArrayAppend, ctx, exec, params[1]);
-        return exec->CreateVar(ctx);
-    }));
-
-    ctx->AddMethod(new RuntimeMethod("len", {"a"}, [](RuntimeCtx *ctx, RuntimeExecutor *exec,
-                                                              const std::vector<RuntimeVar *> &params) -> RuntimeVar * {
-        if (params[0]->GetType()->GetTypeEnum() == ERuntimeType::Array) {
-            auto ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-            ByteStream stream;
-            stream.Write(params[0]->data.arr.size);
-            ret->NativeCtor(stream);
-            return ret;
+        RuntimeMapView dict{ exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Dict)) };
+        RuntimeDict* table = new RuntimeDict();
+        table->Reserve(params.size() / 2);
+        dict.var->data.custom.dataBlob = table;
+        ChargeVarBytes(dict.var, table->GetBytes());
+        for (size_t i = 0; i < params.size() && !exec->IsErrored(); i += 2) {
+            Native_Set(ctx, exec, dict, params[i], params[i + 1]);
         }
-        if (params[0]->GetType()->GetTypeEnum() == ERuntimeType::String) {
-            auto ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-            ByteStream stream;
-            stream.Write(params[0]->data.str.size);
-            ret->NativeCtor(stream);
-            return ret;
+        return exec->IsErrored() ? nullptr : dict.var;
+    }), ENativeEffect::None);
+    AddNative(ctx, MakeNative<&Native_Get>("get"), ENativeEffect::None);
+    AddNative(ctx, MakeNative<&Native_Set>("set"), ENativeEffect::WritesArgs);
+    AddNative(ctx, MakeNative<&Native_Has>("has"), ENativeEffect::None);
+    AddNative(ctx, MakeNative<&Native_Remove>("remove"), ENativeEffect::WritesArgs);
+
+    // sortedmap(k1, v1, k2, v2, ...), keys in < order; later keys win
+    AddNative(ctx, new RuntimeMethod("sortedmap", [](RuntimeCtx *ctx, RuntimeExecutor *exec,
+                                                     RuntimeArgs params) -> RuntimeVar * {
+        if (params.size() % 2) {
+            exec->SetError("sortedmap() takes key, value pairs, got " + std::to_string(params.size()) + " arguments");
+            return 0;
         }
-        exec->SetError("Failed to len(), invalid type " + params[0]->GetType()->GetName() + ", expected Array or String");
-        return 0;
-    }));
+        RuntimeMapView map{ exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::SortedMap)) };
+        RuntimeSortedMap* tree = new RuntimeSortedMap();
+        map.var->data.custom.dataBlob = tree;
+        ChargeVarBytes(map.var, tree->GetBytes());
+        for (size_t i = 0; i < params.size() && !exec->IsErrored(); i += 2) {
+            Native_Set(ctx, exec, map, params[i], params[i + 1]);
+        }
+        return exec->IsErrored() ? nullptr : map.var;
+    }), ENativeEffect::None);
+    AddNative(ctx, MakeNative<&Native_Bound<true>>("lowerbound"), ENativeEffect::None);
+    AddNative(ctx, MakeNative<&Native_Bound<false>>("upperbound"), ENativeEffect::None);
+
+    AddNative(ctx, MakeNative<&Native_Bitset>("bitset"), ENativeEffect::None);
+    AddNative(ctx, MakeNative<&Native_SetBit>("setbit"), ENativeEffect::WritesArgs);
+    AddNative(ctx, MakeNative<&Native_ClearBit>("clearbit"), ENativeEffect::WritesArgs);
+    AddNative(ctx, MakeNative<&Native_TestBit>("testbit"), ENativeEffect::None);
+    AddNative(ctx, MakeNative<&Native_Popcount>("popcount"), ENativeEffect::None);
+    AddNative(ctx, MakeNative<&Native_BitOp<&RuntimeBitset::And>>("bitand"), ENativeEffect::WritesArgs);
+    AddNative(ctx, MakeNative<&Native_BitOp<&RuntimeBitset::Or>>("bitor"), ENativeEffect::WritesArgs);
+    AddNative(ctx, MakeNative<&Native_BitOp<&RuntimeBitset::Xor>>("bitxor"), ENativeEffect::WritesArgs);
+    AddNative(ctx, MakeNative<&Native_BitOp<&RuntimeBitset::AndNot>>("bitandnot"), ENativeEffect::WritesArgs);
+
+    // heap() orders values, heap(1) orders [priority, payload] arrays by priority; pop takes the smallest first
+    AddNative(ctx, new RuntimeMethod("heap", [](RuntimeCtx *ctx, RuntimeExecutor *exec,
+                                                RuntimeArgs params) -> RuntimeVar * {
+        if (params.size() > 1) {
+            exec->SetError("heap() takes 0 or 1 arguments, got " + std::to_string(params.size()));
+            return 0;
+        }
+        bool keyed = false;
+        if (!params.empty()) {
+            if (params[0]->GetType()->GetTypeEnum() != ERuntimeType::Int64) {
+                exec->SetError("heap(): argument 1 should be Int64, got " + params[0]->GetType()->GetName());
+                return 0;
+            }
+            keyed = params[0]->data.i64 != 0;
+        }
+        auto ret = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Heap));
+        RuntimeHeap* heap = new RuntimeHeap(keyed);
+        ret->data.custom.dataBlob = heap;
+        ChargeVarBytes(ret, heap->GetBytes());
+        return ret;
+    }), ENativeEffect::None);
+    AddNative(ctx, MakeNative<&Native_Push>("push"), ENativeEffect::WritesArgs);
+    AddNative(ctx, MakeNative<&Native_Pop>("pop"), ENativeEffect::WritesArgs);
+    AddNative(ctx, MakeNative<&Native_Peek>("peek"), ENativeEffect::None);
+
+    AddNative(ctx, MakeNative<&Native_Deque>("deque"), ENativeEffect::None);
+    AddNative(ctx, MakeNative<&Native_DequePush<true>>("pushfront"), ENativeEffect::WritesArgs);
+    AddNative(ctx, MakeNative<&Native_DequePush<false>>("pushback"), ENativeEffect::WritesArgs);
+    AddNative(ctx, MakeNative<&Native_DequePop<true>>("popfront"), ENativeEffect::WritesArgs);
+    AddNative(ctx, MakeNative<&Native_DequePop<false>>("popback"), ENativeEffect::WritesArgs);
 }
 
 void Precompile::CreateTypes(RuntimeCtx* ctx) {
@@ -608,6 +1195,12 @@ void Precompile::CreateTypes(RuntimeCtx* ctx) {
 	ctx->AddType(Precompile::Type_Double());
 	ctx->AddType(Precompile::Type_String());
     ctx->AddType(Precompile::Type_Array());
+    ctx->AddType(Precompile::Type_Range());
+    ctx->AddType(Precompile::Type_Dict());
+    ctx->AddType(Precompile::Type_Bitset());
+    ctx->AddType(Precompile::Type_Heap());
+    ctx->AddType(Precompile::Type_Deque());
+    ctx->AddType(Precompile::Type_SortedMap());
 
 	AddReservedMethods(ctx);
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "Runtime.h"
+#include <utility>
 
 class Precompile
 {
@@ -9,11 +10,75 @@ private:
 	static RuntimeType* Type_Double();
 	static RuntimeType* Type_String();
 	static RuntimeType* Type_Array();
+	static RuntimeType* Type_Range();
+	// a type holding a T in data.custom, freed with the var, false when empty and as long as T::Size()
+	template<typename T>
+	static RuntimeType* Type_Container(ERuntimeType typeEnum);
+	static RuntimeType* Type_Dict();
+	static RuntimeType* Type_Bitset();
+	static RuntimeType* Type_Heap();
+	static RuntimeType* Type_Deque();
+	static RuntimeType* Type_SortedMap();
 
+	// count copies of a String var, written straight into the result buffer
+	static RuntimeVar* RepeatString(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* str, int64_t count);
 
+	static int64_t Native_Int(RuntimeCtx* ctx, RuntimeExecutor* exec, std::string_view str);
+	static void Native_Append(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeArrayView array, RuntimeVar* item);
+	static int64_t Native_Len(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* value);
+	// get, set, has and remove take a Dict or a SortedMap
+	static RuntimeVar* Native_Get(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeMapView map, RuntimeVar* key);
+	static void Native_Set(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeMapView map, RuntimeVar* key, RuntimeVar* value);
+	static int64_t Native_Has(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeMapView map, RuntimeVar* key);
+	static int64_t Native_Remove(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeMapView map, RuntimeVar* key);
+	// lowerbound and upperbound: rank of the first key not less than, or greater than, key
+	template<bool lower>
+	static int64_t Native_Bound(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeSortedMapView map, RuntimeVar* key);
+
+	static RuntimeVar* Native_Bitset(RuntimeCtx* ctx, RuntimeExecutor* exec, int64_t size);
+	static void Native_SetBit(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeBitsetView bits, int64_t idx);
+	static void Native_ClearBit(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeBitsetView bits, int64_t idx);
+	static int64_t Native_TestBit(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeBitsetView bits, int64_t idx);
+	static int64_t Native_Popcount(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeBitsetView bits);
+	// bitand, bitor, bitxor and bitandnot: the first bitset becomes first op second, in place
+	template<void (RuntimeBitset::*Op)(const RuntimeBitset&)>
+	static void Native_BitOp(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeBitsetView dst, RuntimeBitsetView src);
+
+	static void Native_Push(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeHeapView heap, RuntimeVar* value);
+	static RuntimeVar* Native_Pop(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeHeapView heap);
+	static RuntimeVar* Native_Peek(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeHeapView heap);
+
+	static RuntimeVar* Native_Deque(RuntimeCtx* ctx, RuntimeExecutor* exec);
+	// pushfront and pushback
+	template<bool front>
+	static void Native_DequePush(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeDequeView deque, RuntimeVar* value);
+	// popfront and popback
+	template<bool front>
+	static RuntimeVar* Native_DequePop(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeDequeView deque);
+
+	// false with the executor errored when idx is not a bit of bits
+	static bool BitIndex(RuntimeExecutor* exec, const char* method, RuntimeBitsetView bits, int64_t idx);
+	// hash of a dict key, false with the executor errored for types a dict can not hold
+	static bool DictKey(RuntimeExecutor* exec, const char* method, RuntimeVar* key, uint64_t& hash);
+	// false with the executor errored for keys without a < operator
+	static bool SortedKey(RuntimeExecutor* exec, const char* method, RuntimeVar* key);
+	// value slot of key in map, nullptr when it is absent or the key is invalid; hash is set for a Dict
+	static RuntimeVar** FindValue(RuntimeCtx* ctx, RuntimeExecutor* exec, const char* method, RuntimeMapView map, RuntimeVar* key, uint64_t& hash);
+
+	// what a native does besides returning its result, declared once where it is registered
+	enum class ENativeEffect {
+		None, // only reads its arguments
+		WritesArgs, // may write the vars passed to it, see Optimizer::MayMutateArgs
+		External, // input or output, so never pure; reads its arguments only
+	};
+	static void AddNative(RuntimeCtx* ctx, RuntimeMethod* method, ENativeEffect effect);
 	static void AddReservedMethods(RuntimeCtx* ctx);
 
 public:
 	static void CreateTypes(RuntimeCtx* ctx);
+
+	// a < b through the CompareLess operator of a, with Int64 and Double pairs compared inline; false with the
+	// executor errored when the operator fails, and false without a call once it has. The order of Heap and SortedMap.
+	static bool Less(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* a, RuntimeVar* b);
 };
 
@@ -1,13 +1,26 @@
 #include "Runtime.h"
 #include "Precompile.h"
 #include "Parser.h"
+#include "PassManager.h"
+#include "Optimizer.h"
+#include "GC.h"
+#include "Dict.h"
+#include "Bitset.h"
+#include "Heap.h"
+#include "Deque.h"
+#include "SortedMap.h"
 #include <cassert>
 #include <queue>
+#include <algorithm>
+#include <new>
+#include <bit>
 
 void RuntimeMethod::FromPoliz(RuntimeCtx* ctx, const std::vector<PolizEntry>& poliz) {
 	std::vector<RuntimeInstr> cmd;
 
 	std::stack<PolizEntry> stack;
+	std::stack<std::string> pendingTests; // results of && and || awaiting their right side
+	RuntimeSwitchTable pendingCases;
 
 	int retCnt = 1;
 	int ctorCnt = 1;
@@ -27,7 +40,7 @@ void RuntimeMethod::FromPoliz(RuntimeCtx* ctx, const std::vector<PolizEntry>& po
 		}
 		else if (entry.cmd == PolizCmd::ConstInt) {
 			instr.AddParam<TID>(Hash{}("Int64"));
-			instr.AddParam(std::stoll(entry.operand.c_str()));
+			instr.AddParam<int64_t>(std::stoll(entry.operand.c_str()));
 		}
         else if (entry.cmd == PolizCmd::ConstDbl) {
             instr.AddParam<TID>(Hash{}("Double"));
@@ -116,6 +129,20 @@ void RuntimeMethod::FromPoliz(RuntimeCtx* ctx, const std::vector<PolizEntry>& po
 			}
 			stack.push(PolizEntry{ -1, PolizCmd::Var, retName, entry.polizEntryIdx });
 
+			// builtins with their own opcode skip the param pack and native dispatch
+			static const std::map<std::string, RuntimeInstrType> intrinsics = {
+				{ "len", RuntimeInstrType::Len }, { "append", RuntimeInstrType::Append }, { "int", RuntimeInstrType::ToInt },
+			};
+			auto intrinsic = intrinsics.find(entry.operand);
+			if (def->IsNative() && intrinsic != intrinsics.end()) {
+				RuntimeInstr inl(intrinsic->second);
+				for (size_t i = 0; i < call.GetParamCount(); ++i) {
+					if (i != 1)
+						inl.AddParam(call.GetParam<std::string>(i));
+				}
+				call = inl;
+			}
+
 			cmd.push_back(call);
 			break;
 		}
@@ -193,6 +220,89 @@ void RuntimeMethod::FromPoliz(RuntimeCtx* ctx, const std::vector<PolizEntry>& po
                 cmd.push_back(jz);
                 break;
             }
+		case PolizCmd::RangeInit: {
+			PolizEntry range = stack.top();
+			stack.pop();
+			PolizEntry itr = stack.top();
+			stack.pop();
+			RuntimeInstr init(RuntimeInstrType::RangeInit);
+			init.AddParam(CreateScriptingInst(init, itr));
+			init.AddParam(CreateScriptingInst(init, range));
+
+			cmd.push_back(init);
+			break;
+		}
+		case PolizCmd::RangeNext: {
+			PolizEntry range = stack.top();
+			stack.pop();
+			PolizEntry itr = stack.top();
+			stack.pop();
+			PolizEntry target = stack.top();
+			stack.pop();
+			int64_t delta = std::stoll(entry.operand);
+			RuntimeInstr next(RuntimeInstrType::RangeNext);
+			next.AddParam<int64_t>(delta + i);
+			next.AddParam(CreateScriptingInst(next, range));
+			next.AddParam(CreateScriptingInst(next, itr));
+			next.AddParam(CreateScriptingInst(next, target));
+
+			cmd.push_back(next);
+			break;
+		}
+		case PolizCmd::AndJump:
+		case PolizCmd::OrJump: {
+			PolizEntry left = stack.top();
+			stack.pop();
+			std::string retName = "$ret" + std::to_string(retCnt++);
+			RuntimeInstr test(RuntimeInstrType::Test);
+			test.AddParam(retName);
+			test.AddParam(CreateScriptingInst(test, left));
+			cmd.push_back(test);
+
+			RuntimeInstr jump(entry.cmd == PolizCmd::AndJump ? RuntimeInstrType::Jz : RuntimeInstrType::Jnz);
+			jump.AddParam<int64_t>(std::stoll(entry.operand) + i);
+			jump.AddParam(retName);
+			cmd.push_back(jump);
+			pendingTests.push(retName);
+			break;
+		}
+		case PolizCmd::Test: {
+			PolizEntry right = stack.top();
+			stack.pop();
+			std::string retName = pendingTests.top();
+			pendingTests.pop();
+			RuntimeInstr test(RuntimeInstrType::Test);
+			test.AddParam(retName);
+			test.AddParam(CreateScriptingInst(test, right));
+			cmd.push_back(test);
+
+			stack.push(PolizEntry{ -1, PolizCmd::Var, retName, right.polizEntryIdx });
+			break;
+		}
+		case PolizCmd::Case: {
+			PolizEntry key = stack.top();
+			stack.pop();
+			int64_t target = std::stoll(entry.operand) + i;
+			if (key.cmd == PolizCmd::Str)
+				pendingCases.AddCase(key.operand, target);
+			else
+				pendingCases.AddCase((int64_t)std::stoll(key.operand), target);
+			break;
+		}
+		case PolizCmd::Switch: {
+			PolizEntry value = stack.top();
+			stack.pop();
+			int64_t defaultTarget = std::stoll(entry.operand) + i;
+			RuntimeInstr sw(RuntimeInstrType::Switch);
+			sw.AddParam<int64_t>(defaultTarget);
+			sw.AddParam(CreateScriptingInst(sw, value));
+			pendingCases.Compact(defaultTarget);
+			sw.AddParam(pendingCases);
+			pendingCases = RuntimeSwitchTable();
+
+			cmd.push_back(sw);
+			break;
+		}
 		case PolizCmd::Jump: {
 			PolizEntry actionVar = stack.top();
 			int64_t delta = std::stoll(entry.operand);
@@ -226,12 +336,19 @@ void RuntimeMethod::FromPoliz(RuntimeCtx* ctx, const std::vector<PolizEntry>& po
 	// jmp rebase
 	for (int64_t i = 0; i < cmd.size(); ++i) {
 		auto& instr = cmd[i];
-		if (instr.opcode != RuntimeInstrType::Jmp && instr.opcode != RuntimeInstrType::Jz && instr.opcode != RuntimeInstrType::Jge)
+		if (!instr.IsJump())
 			continue;
-		int64_t& base = instr.RefParam<int64_t>(0);
-		base = addrMap[base] - i - 1;
+		std::vector<int64_t> deltas = instr.GetJumpDeltas();
+		for (auto& delta : deltas) {
+			delta = addrMap[delta] - i - 1;
+		}
+		instr.SetJumpDeltas(deltas);
 	}
 
+	ControlFlowGraph cfg(cmd);
+	PassManager::CreateDefault(ctx->GetOptLevel(), ctx->GetDisabledPasses()).Run(ctx, cfg);
+	cmd = cfg.Flatten();
+
 	//print
 	for (auto& instr : cmd) {
 		std::cout << RuntimeInstrType_ToString(instr.opcode) << "  ";
@@ -249,10 +366,10 @@ void RuntimeMethod::FromPoliz(RuntimeCtx* ctx, const std::vector<PolizEntry>& po
 std::vector<uint8_t> RuntimeInstr::GetRawParam(size_t idx) const {
 	auto& value = this->params[idx];
 
-	ByteStream bf_write;
+	ByteWriter bf_write;
 
 	if (value.type() == typeid(std::string))
-		bf_write.Write(std::any_cast<std::string>(value));
+		bf_write.Write(std::any_cast<const std::string&>(value));
 	if (value.type() == typeid(int64_t))
 		bf_write.Write(std::any_cast<int64_t>(value));
     if (value.type() == typeid(double))
@@ -262,8 +379,137 @@ std::vector<uint8_t> RuntimeInstr::GetRawParam(size_t idx) const {
 	if (value.type() == typeid(ERuntimeCallType))
 		bf_write.Write(std::any_cast<ERuntimeCallType>(value));
 
-	return bf_write.GetBuffer();
+	return bf_write.Release();
+}
+
+std::vector<int64_t> RuntimeInstr::GetJumpDeltas() const {
+	std::vector<int64_t> deltas = { this->GetParam<int64_t>(0) };
+	if (this->opcode == RuntimeInstrType::Switch) {
+		auto& table = this->GetParam<RuntimeSwitchTable>(2);
+		deltas.insert(deltas.end(), table.deltas.begin(), table.deltas.end());
+	}
+	return deltas;
+}
+
+void RuntimeInstr::SetJumpDeltas(const std::vector<int64_t>& deltas) {
+	this->RefParam<int64_t>(0) = deltas[0];
+	if (this->opcode == RuntimeInstrType::Switch) {
+		auto& table = this->RefParam<RuntimeSwitchTable>(2);
+		std::copy(deltas.begin() + 1, deltas.end(), table.deltas.begin());
+	}
+}
+
+void RuntimeSwitchTable::AddCase(int64_t key, int64_t delta) {
+	this->intSlots[key] = this->deltas.size();
+	this->deltas.push_back(delta);
+}
+
+void RuntimeSwitchTable::AddCase(const std::string& key, int64_t delta) {
+	this->stringSlots[key] = this->deltas.size();
+	this->deltas.push_back(delta);
+}
+
+void RuntimeSwitchTable::Compact(int64_t defaultDelta) {
+	if (this->intSlots.size() < 2 || !this->stringSlots.empty())
+		return;
+	int64_t lo = INT64_MAX, hi = INT64_MIN;
+	for (auto& [key, slot] : this->intSlots) {
+		lo = std::min(lo, key);
+		hi = std::max(hi, key);
+	}
+	uint64_t range = (uint64_t)hi - (uint64_t)lo + 1;
+	if (range > 2 * this->intSlots.size() || range > 4096)
+		return;
+
+	std::vector<int64_t> table(range, defaultDelta);
+	for (auto& [key, slot] : this->intSlots) {
+		table[key - lo] = this->deltas[slot];
+	}
+	this->deltas = table;
+	this->intSlots.clear();
+	this->base = lo;
+	this->dense = true;
+}
+
+int64_t RuntimeSwitchTable::Find(RuntimeVar* value, int64_t defaultDelta) const {
+	ERuntimeType type = value->GetType()->GetTypeEnum();
+	if (type == ERuntimeType::Int64) {
+		if (this->dense) {
+			uint64_t slot = (uint64_t)value->data.i64 - (uint64_t)this->base;
+			return slot < this->deltas.size() ? this->deltas[slot] : defaultDelta;
+		}
+		auto it = this->intSlots.find(value->data.i64);
+		return it != this->intSlots.end() ? this->deltas[it->second] : defaultDelta;
+	}
+	if (type == ERuntimeType::String) {
+		auto it = this->stringSlots.find(std::string_view(value->data.str.ptr, value->data.str.size));
+		return it != this->stringSlots.end() ? this->deltas[it->second] : defaultDelta;
+	}
+	return defaultDelta;
+}
+
+std::vector<std::string> RuntimeInstr::GetDefinedVars() const {
+	switch (this->opcode) {
+	case RuntimeInstrType::Ctor:
+	case RuntimeInstrType::Operation:
+	case RuntimeInstrType::UnOperation:
+	case RuntimeInstrType::Call:
+	case RuntimeInstrType::Array:
+	case RuntimeInstrType::ArrayAccess:
+	case RuntimeInstrType::RangeInit:
+	case RuntimeInstrType::Test:
+	case RuntimeInstrType::Const:
+	case RuntimeInstrType::Len:
+	case RuntimeInstrType::Append:
+	case RuntimeInstrType::ToInt:
+		return { this->GetParam<std::string>(0) };
+	case RuntimeInstrType::RangeNext:
+		return { this->GetParam<std::string>(2), this->GetParam<std::string>(3) };
+	default:
+		return {};
+	}
+}
+
+std::pair<size_t, size_t> RuntimeInstr::GetUsedParams() const {
+	switch (this->opcode) {
+	case RuntimeInstrType::Ret:
+		return { 0, 1 };
+	case RuntimeInstrType::RangeNext:
+		return { 1, 3 };
+	case RuntimeInstrType::Switch:
+		return { 1, 2 };
+	case RuntimeInstrType::Array:
+	case RuntimeInstrType::Jz:
+	case RuntimeInstrType::Jnz:
+	case RuntimeInstrType::Jge:
+	case RuntimeInstrType::Test:
+	case RuntimeInstrType::RangeInit:
+	case RuntimeInstrType::ArrayAccess:
+	case RuntimeInstrType::Len:
+	case RuntimeInstrType::Append:
+	case RuntimeInstrType::ToInt:
+		return { 1, this->GetParamCount() };
+	case RuntimeInstrType::Operation:
+		if (this->GetParam<ERuntimeCallType>(1) == ERuntimeCallType::Assign)
+			return { 3, 4 }; // param 2 repeats the target, which is only written
+		return { 2, this->GetParamCount() };
+	case RuntimeInstrType::UnOperation:
+	case RuntimeInstrType::Call:
+		return { 2, this->GetParamCount() };
+	default:
+		return { 0, 0 };
+	}
 }
+
+std::vector<std::string> RuntimeInstr::GetUsedVars() const {
+	std::vector<std::string> used;
+	auto [first, last] = this->GetUsedParams();
+	for (size_t i = first; i < last; ++i) {
+		used.push_back(this->GetParam<std::string>(i));
+	}
+	return used;
+}
+
 std::string RuntimeInstr::GetParamString(RuntimeCtx* ctx, size_t idx) const {
 	auto& value = this->params[idx];
 	if (value.type() == typeid(std::string))
@@ -280,20 +526,59 @@ std::string RuntimeInstr::GetParamString(RuntimeCtx* ctx, size_t idx) const {
 	}
 	if (value.type() == typeid(ERuntimeCallType))
 		return ERuntimeCallType_ToString(std::any_cast<ERuntimeCallType>(value));
+	if (value.type() == typeid(RuntimeVar*))
+		return "const " + std::any_cast<RuntimeVar*>(value)->GetType()->GetName();
+	if (value.type() == typeid(RuntimeSwitchTable)) {
+		auto& table = std::any_cast<const RuntimeSwitchTable&>(value);
+		if (table.dense)
+			return "table[" + std::to_string(table.base) + ".." + std::to_string(table.base + (int64_t)table.deltas.size() - 1) + "]";
+		return "hashed[" + std::to_string(table.deltas.size()) + "]";
+	}
 	std::cout << "Unknown ret type " << std::string(value.type().name()) << std::endl;
 	assert(false);
 }
 
-RuntimeVar* RuntimeExecutor::CreateVar(RuntimeCtx* ctx) {
-	for (auto& [begin, pool] : this->varPool) {
-		RuntimeVar* var = pool.Pop();
-		if (var) return var;
+RuntimeExecutor::RuntimeExecutor() : ip(INVALID_REG_VALUE), lastErrorIp(INVALID_REG_VALUE), isErrored(false), varPool(&this->memory), region(&this->memory), currentScope(nullptr), steps(0), liveVars(0), depth(0) {
+	this->collector = new GarbageCollector(this);
+	this->gcTrigger = this->collector->GetTrigger();
+}
+RuntimeExecutor::~RuntimeExecutor() {
+	if (this->currentScope) {
+		delete this->currentScope;
+		this->currentScope = nullptr;
 	}
-	// create pool
-	//printf("[dbg] Allocating VarPool: %d\n", 1000);
-	auto pool = VarPool<RuntimeVar>(ctx, 1000);
-	this->varPool[pool.block] = pool;
-	return this->CreateVar(ctx);
+	delete this->collector;
+}
+
+void RuntimeExecutor::SetGcPolicy(const GcPolicy& policy) {
+	this->collector->SetPolicy(policy);
+	this->gcTrigger = this->collector->GetTrigger();
+}
+const GcStats& RuntimeExecutor::GetGcStats() const {
+	return this->collector->GetStats();
+}
+void RuntimeExecutor::CollectGarbage(RuntimeCtx* ctx) {
+	this->collector->Collect(ctx);
+	this->gcTrigger = this->collector->GetTrigger();
+}
+void RuntimeExecutor::ReleaseVars(RuntimeCtx* ctx) {
+	this->region.Clear(ctx);
+	this->pinned.clear();
+	this->collector->ReleaseAll(ctx);
+}
+
+RuntimeVar* RuntimeExecutor::CreateVar(RuntimeCtx* ctx) {
+	if (this->limits.vars && this->liveVars >= this->limits.vars && !this->isErrored)
+		this->SetError("Memory limit exceeded: more than " + std::to_string(this->limits.vars) + " vars");
+	this->liveVars += 1;
+	return this->varPool.Pop(ctx);
+}
+bool RuntimeExecutor::ReserveBytes(size_t size) {
+	if (!this->limits.bytes || (size <= this->limits.bytes && this->memory.bytes <= this->limits.bytes - size))
+		return true;
+	if (!this->isErrored)
+		this->SetError("Memory limit exceeded: more than " + std::to_string(this->limits.bytes) + " bytes");
+	return false;
 }
 RuntimeVar* RuntimeExecutor::CreateTypedVar(RuntimeCtx* ctx, RuntimeType* type) {
 	RuntimeVar* var = this->CreateVar(ctx);
@@ -302,23 +587,201 @@ RuntimeVar* RuntimeExecutor::CreateTypedVar(RuntimeCtx* ctx, RuntimeType* type)
 	return var;
 }
 
+RuntimeVar* RuntimeExecutor::CreateInt64(RuntimeCtx* ctx, int64_t value) {
+	if (RuntimeVar* shared = ctx->GetSmallInt(value))
+		return shared;
+	RuntimeVar* var = this->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
+	var->data.i64 = value;
+	return var;
+}
+
 void RuntimeExecutor::ReturnVar(RuntimeCtx* ctx, RuntimeVar* var) {
-	auto ownerPool = this->varPool.lower_bound(var);
-	if (ownerPool == this->varPool.end() || ownerPool->first != var)
-		--ownerPool;
-	if (!ownerPool->second.Return(ctx, var)) {
-		printf("ReturnVar: Pool errored\n");
+	if (ctx->IsImmortal(var))
+		return;
+	this->varPool.Return(ctx, var);
+	this->liveVars -= 1;
+}
+
+VarPool::~VarPool() {
+	for (Chunk* chunk : this->chunks) {
+		::operator delete(chunk, std::align_val_t(chunkAlign));
+	}
+}
+
+void VarPool::Refill(RuntimeCtx* ctx) {
+	// previous current chunk is full, it comes back through Return
+	if (!this->available.empty()) {
+		this->current = this->available.back();
+		this->available.pop_back();
+		return;
+	}
+
+	size_t size = this->chunks.empty() ? firstChunkSize : std::min(this->chunks.back()->size * 2, maxChunkSize);
+	Chunk* chunk = static_cast<Chunk*>(::operator new(Chunk::Bytes(size), std::align_val_t(chunkAlign)));
+	chunk->owner = this;
+	chunk->usage = this->usage;
+	chunk->size = size;
+	this->usage->Charge(Chunk::Bytes(size));
+	chunk->used = 0;
+	chunk->freeList = nullptr;
+	std::fill_n(chunk->Allocated(), chunk->Words() * 2, 0);
+	RuntimeVar* vars = chunk->Vars();
+	RuntimeType* nullType = ctx->GetType(ERuntimeType::Null);
+	// thread back to front so the chunk is handed out in address order
+	for (size_t i = size; i-- > 0;) {
+		RuntimeVar* var = new (vars + i) RuntimeVar();
+		var->SetType(nullType);
+		var->data.custom.dataBlob = chunk->freeList;
+		chunk->freeList = var;
+	}
+	this->chunks.push_back(chunk);
+	this->current = chunk;
+	this->stats.capacity += size;
+	this->stats.peakCapacity = std::max(this->stats.peakCapacity, this->stats.capacity);
+	this->stats.chunks += 1;
+}
+
+bool VarPool::Release(Chunk* chunk) {
+	if (chunk == this->current || this->stats.capacity - chunk->size < this->policy.retainVars)
+		return false;
+	this->available.erase(std::find(this->available.begin(), this->available.end(), chunk));
+	this->chunks.erase(std::find(this->chunks.begin(), this->chunks.end(), chunk));
+	this->stats.capacity -= chunk->size;
+	this->stats.chunks -= 1;
+	this->stats.trimmedChunks += 1;
+	this->usage->Credit(Chunk::Bytes(chunk->size));
+	::operator delete(chunk, std::align_val_t(chunkAlign));
+	return true;
+}
+
+void VarPool::Trim() {
+	if (this->collecting)
+		return;
+	// largest chunks first, they free the most per call
+	std::vector<Chunk*> empty;
+	for (Chunk* chunk : this->chunks) {
+		if (chunk->used == 0)
+			empty.push_back(chunk);
+	}
+	std::sort(empty.begin(), empty.end(), [](Chunk* a, Chunk* b) { return a->size > b->size; });
+	for (Chunk* chunk : empty) {
+		this->Release(chunk);
+	}
+}
+
+void VarPool::BeginCollection() {
+	for (Chunk* chunk : this->chunks) {
+		std::fill_n(chunk->Marks(), chunk->Words(), 0);
+	}
+	this->collecting = true;
+	this->sweepChunk = 0;
+	this->sweepWord = 0;
+}
+
+void VarPool::EndCollection() {
+	this->collecting = false;
+	if (this->policy.trim == EVarPoolTrim::Eager)
+		this->Trim();
+}
+
+bool VarPool::Sweep(RuntimeCtx* ctx, size_t budget, size_t& freed) {
+	// chunks are neither released nor reordered while collecting, new ones are appended and hold no garbage
+	while (this->sweepChunk < this->chunks.size()) {
+		Chunk* chunk = this->chunks[this->sweepChunk];
+		for (; this->sweepWord < chunk->Words(); ++this->sweepWord) {
+			if (budget < 64)
+				return false;
+			budget -= 64;
+			uint64_t garbage = chunk->Allocated()[this->sweepWord] & ~chunk->Marks()[this->sweepWord];
+			while (garbage) {
+				int bit = std::countr_zero(garbage);
+				garbage &= garbage - 1;
+				this->Return(ctx, chunk->Vars() + this->sweepWord * 64 + bit);
+				freed += 1;
+			}
+		}
+		this->sweepChunk += 1;
+		this->sweepWord = 0;
+	}
+	return true;
+}
+
+VarPoolStats VarPool::GetStats() const {
+	VarPoolStats stats = this->stats;
+	for (Chunk* chunk : this->chunks) {
+		stats.live += chunk->used;
+	}
+	return stats;
+}
+
+bool VarPool::Owns(RuntimeVar* var) const {
+	Chunk* chunk = ChunkOf(var);
+	return std::find(this->chunks.begin(), this->chunks.end(), chunk) != this->chunks.end() &&
+		var >= chunk->Vars() && var < chunk->Vars() + chunk->size;
+}
+
+static void StoreInt64(RuntimeCtx* ctx, RuntimeVar* var, int64_t value) {
+	if (var->GetType()->GetTypeEnum() != ERuntimeType::Int64) {
+		var->NativeTypeConvert(ctx->GetType(ERuntimeType::Null));
+		var->NativeTypeConvert(ctx->GetType(ERuntimeType::Int64));
+	}
+	var->data.i64 = value;
+}
+static void StoreDouble(RuntimeCtx* ctx, RuntimeVar* var, double value) {
+	if (var->GetType()->GetTypeEnum() != ERuntimeType::Double) {
+		var->NativeTypeConvert(ctx->GetType(ERuntimeType::Null));
+		var->NativeTypeConvert(ctx->GetType(ERuntimeType::Double));
+	}
+	var->data.dbl = value;
+}
+
+VarRegion::~VarRegion() {
+	if (this->block)
+		::operator delete(this->block, std::align_val_t(VarPool::chunkAlign));
+}
+
+RuntimeVar* VarRegion::Push(RuntimeCtx* ctx, size_t count) {
+	if (!this->block) {
+		this->block = static_cast<Block*>(::operator new(VarPool::chunkAlign, std::align_val_t(VarPool::chunkAlign)));
+		this->block->owner = this;
+		this->block->usage = this->usage;
 	}
+	if (count > capacity - this->top)
+		return nullptr;
+	this->usage->Charge(count * sizeof(RuntimeVar));
+	RuntimeVar* base = this->block->Vars() + this->top;
+	RuntimeType* nullType = ctx->GetType(ERuntimeType::Null);
+	for (size_t i = 0; i < count; ++i) {
+		new (base + i) RuntimeVar();
+		base[i].SetType(nullType);
+	}
+	this->top += count;
+	return base;
+}
+
+void VarRegion::Pop(RuntimeCtx* ctx, RuntimeVar* base) {
+	RuntimeType* nullType = ctx->GetType(ERuntimeType::Null);
+	RuntimeVar* end = this->block->Vars() + this->top;
+	for (RuntimeVar* var = base; var != end; ++var) {
+		ERuntimeType type = var->GetType()->GetTypeEnum();
+		if (type != ERuntimeType::Null && type != ERuntimeType::Int64 && type != ERuntimeType::Double)
+			var->NativeTypeConvert(nullType);
+	}
+	this->usage->Credit((end - base) * sizeof(RuntimeVar));
+	this->top = base - this->block->Vars();
 }
 
 void LocalScope::Destroy(RuntimeExecutor* exec, RuntimeCtx* ctx) {
 	for (auto& [n, state] : this->locals) {
-		exec->ReturnVar(ctx, state.var);
+		if (!state.borrowed && state.var) // natives return null on error
+			exec->ReturnVar(ctx, state.var);
 	}
 	this->locals.clear();
 	this->parentLocals.clear();
 }
 LocalVarState LocalScope::GetLocal(RuntimeExecutor* exec, RuntimeCtx* ctx, const std::string name) {
+	if (RuntimeVar* slot = this->FindSlot(name))
+		return { slot, false };
 	auto it = this->locals.find(name);
 	if (it == this->locals.end()) {
 		auto it2 = this->parentLocals.find(name);
@@ -346,14 +809,52 @@ void LocalScope::SetLocal(RuntimeExecutor* exec, RuntimeCtx* ctx, const std::str
 		return;
 	}
 
+	if (RuntimeVar* slot = this->FindSlot(varName)) {
+		// the slot stays where it is: it takes over the value and the emptied var goes back to the pool
+		if (next && ctx->IsImmortal(next)) {
+			StoreInt64(ctx, slot, next->data.i64);
+		}
+		else if (next) {
+			RuntimeType* nullType = ctx->GetType(ERuntimeType::Null);
+			slot->NativeTypeConvert(nullType);
+			*slot = *next;
+			next->SetType(nullType);
+			exec->ReturnVar(ctx, next);
+		}
+		return;
+	}
 	auto it = this->locals.find(varName);
 	if (it == this->locals.end()) {
 		assert(false); // ??
 		return;
 	}
 	LocalVarState& state = it->second;
-	exec->ReturnVar(ctx, state.var);
+	if (next && ctx->IsImmortal(next)) {
+		// shared values are copied into a var of the scope, never held
+		if (state.borrowed) {
+			state.var = exec->CreateVar(ctx);
+			state.borrowed = false;
+		}
+		StoreInt64(ctx, state.var, next->data.i64);
+		return;
+	}
+	if (!state.borrowed)
+		exec->ReturnVar(ctx, state.var);
 	state.var = next;
+	state.borrowed = false;
+}
+void LocalScope::BorrowLocal(RuntimeExecutor* exec, RuntimeCtx* ctx, const std::string& varName, RuntimeVar* alias) {
+	assert(!this->FindSlot(varName)); // element aliases never get a slot
+	auto it = this->locals.find(varName);
+	if (it == this->locals.end()) {
+		assert(false); // ??
+		return;
+	}
+	LocalVarState& state = it->second;
+	if (!state.borrowed)
+		exec->ReturnVar(ctx, state.var);
+	state.var = alias;
+	state.borrowed = true;
 }
 
 LocalVarState RuntimeExecutor::GetLocal(RuntimeCtx* ctx, const std::string& name) {
@@ -362,6 +863,71 @@ LocalVarState RuntimeExecutor::GetLocal(RuntimeCtx* ctx, const std::string& name
 void RuntimeExecutor::SetLocal(RuntimeCtx* ctx, const std::string& varName, RuntimeVar* next) {
 	return this->currentScope->SetLocal(this, ctx, varName, next, false);
 }
+// Int64/Double arithmetic written straight into dest, which may be an operand. Same results as the Int64 and Double
+// operators of Precompile; false for everything they allocate for or fail on (strings, division by zero, % and //
+// of doubles), which then goes through the operator.
+static bool ScalarArithmetic(RuntimeCtx* ctx, ERuntimeCallType op, RuntimeVar* p1, RuntimeVar* p2, RuntimeVar* dest) {
+	ERuntimeType t1 = p1->GetType()->GetTypeEnum();
+	ERuntimeType t2 = p2 ? p2->GetType()->GetTypeEnum() : ERuntimeType::Int64;
+	if ((t1 != ERuntimeType::Int64 && t1 != ERuntimeType::Double) || (t2 != ERuntimeType::Int64 && t2 != ERuntimeType::Double))
+		return false;
+
+	if (t1 == ERuntimeType::Int64 && t2 == ERuntimeType::Int64) {
+		int64_t a = p1->data.i64;
+		int64_t b = p2 ? p2->data.i64 : 0;
+		switch (op) {
+		case ERuntimeCallType::Add: StoreInt64(ctx, dest, a + b); return true;
+		case ERuntimeCallType::Sub: StoreInt64(ctx, dest, a - b); return true;
+		case ERuntimeCallType::Mult: StoreInt64(ctx, dest, a * b); return true;
+		case ERuntimeCallType::UnMinus: StoreInt64(ctx, dest, -a); return true;
+		case ERuntimeCallType::Div:
+			if (b == 0)
+				return false;
+			StoreDouble(ctx, dest, (double)a / b);
+			return true;
+		case ERuntimeCallType::IntDiv:
+			if (b == 0)
+				return false;
+			StoreInt64(ctx, dest, a / b);
+			return true;
+		case ERuntimeCallType::Remainder:
+			if (b == 0)
+				return false;
+			StoreInt64(ctx, dest, a % b);
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	double a = t1 == ERuntimeType::Int64 ? (double)p1->data.i64 : p1->data.dbl;
+	double b = !p2 ? 0 : t2 == ERuntimeType::Int64 ? (double)p2->data.i64 : p2->data.dbl;
+	switch (op) {
+	case ERuntimeCallType::Add: StoreDouble(ctx, dest, a + b); return true;
+	case ERuntimeCallType::Sub: StoreDouble(ctx, dest, a - b); return true;
+	case ERuntimeCallType::Mult: StoreDouble(ctx, dest, a * b); return true;
+	case ERuntimeCallType::UnMinus: StoreDouble(ctx, dest, -a); return true;
+	case ERuntimeCallType::Div:
+		if (b == 0)
+			return false;
+		StoreDouble(ctx, dest, a / b);
+		return true;
+	case ERuntimeCallType::IntDiv:
+		if (t1 != ERuntimeType::Int64 || b == 0)
+			return false;
+		StoreInt64(ctx, dest, (int64_t)(p1->data.i64 / b));
+		return true;
+	default:
+		return false;
+	}
+}
+
+void RuntimeExecutor::WriteInt64(RuntimeCtx* ctx, const std::string& varName, int64_t value) {
+	StoreInt64(ctx, this->GetLocal(ctx, varName).var, value);
+}
+void RuntimeExecutor::BorrowLocal(RuntimeCtx* ctx, const std::string& varName, RuntimeVar* alias) {
+	return this->currentScope->BorrowLocal(this, ctx, varName, alias);
+}
 
 RuntimeVar* RuntimeExecutor::ExecuteInstr(RuntimeCtx* ctx, RuntimeInstr* instr) {
 	//printf("Executing instruction %s\n", RuntimeInstrType_ToString(instr->opcode).c_str());
@@ -371,14 +937,14 @@ RuntimeVar* RuntimeExecutor::ExecuteInstr(RuntimeCtx* ctx, RuntimeInstr* instr)
 		LocalVarState local = this->GetLocal(ctx, bret);
 		if (local.var->GetType()->GetTypeEnum() != ERuntimeType::Null)
 			local.var->NativeTypeConvert(ctx->GetType(ERuntimeType::Null)); // reset var so we don't convert
-		TID targetType = instr->GetParam<TID>(1);
-		local.var->NativeTypeConvert(ctx->GetType(targetType));
-
-		ByteStream writer;
-		for (size_t i = 2; i < instr->GetParamCount(); ++i) {
-			writer.Write(instr->GetRawParam(i));
-		}
- 		local.var->NativeCtor(writer.GetBuffer());
+		local.var->ConstructFrom(ctx, *instr);
+	}
+	else if (instr->opcode == RuntimeInstrType::Const) {
+		auto& bret = instr->GetParam<std::string>(0);
+		LocalVarState local = this->GetLocal(ctx, bret);
+		if (local.var->GetType()->GetTypeEnum() != ERuntimeType::Null)
+			local.var->NativeTypeConvert(ctx->GetType(ERuntimeType::Null));
+		local.var->CopyFrom(ctx, this, instr->GetParam<RuntimeVar*>(1));
 	}
 	else if (instr->opcode == RuntimeInstrType::UnOperation) {
 		auto& bret = instr->GetParam<std::string>(0);
@@ -389,9 +955,10 @@ RuntimeVar* RuntimeExecutor::ExecuteInstr(RuntimeCtx* ctx, RuntimeInstr* instr)
 		LocalVarState p1 = this->GetLocal(ctx, bp1);
 
 		if (callType == ERuntimeCallType::UnNot) {
-			RuntimeVar* newRet = this->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-			newRet->data.i64 = p1.var->IsFalse();
-			this->SetLocal(ctx, bret, newRet);
+			this->WriteInt64(ctx, bret, p1.var->IsFalse());
+		}
+		else if (!ret.borrowed && ScalarArithmetic(ctx, callType, p1.var, nullptr, ret.var)) {
+			// Int64/Double result written in place
 		}
 		else {
             if(p1.var->GetType()->HasOperator(callType)){
@@ -414,7 +981,7 @@ RuntimeVar* RuntimeExecutor::ExecuteInstr(RuntimeCtx* ctx, RuntimeInstr* instr)
 		if (callType == ERuntimeCallType::Assign) {
 			if (ret.var->GetType()->GetTypeEnum() != ERuntimeType::Null)
 				ret.var->NativeTypeConvert(ctx->GetType(ERuntimeType::Null));
-			ret.var->CopyFrom(ctx, ctx->GetExecutor(), target.var);
+			ret.var->CopyFrom(ctx, this, target.var);
 		}
 		else {
 			const string& bp1 = instr->GetParam<std::string>(2);
@@ -425,8 +992,9 @@ RuntimeVar* RuntimeExecutor::ExecuteInstr(RuntimeCtx* ctx, RuntimeInstr* instr)
 			if (callType == ERuntimeCallType::CompareNotEq) {
 				RuntimeVar* newRet = p1.var->CallOperator(ERuntimeCallType::CompareEq, ctx, this, p2.var);
 				if (newRet) {
-					newRet->data.i64 = !newRet->data.i64;
-					this->SetLocal(ctx, bret, newRet);
+					bool notEq = !newRet->data.i64;
+					this->ReturnVar(ctx, newRet);
+					this->WriteInt64(ctx, bret, notEq);
 				}
 				else {
 					this->SetError("Illegal operation: " + p1.var->GetType()->GetName() + " != " + p2.var->GetType()->GetName());
@@ -458,16 +1026,17 @@ RuntimeVar* RuntimeExecutor::ExecuteInstr(RuntimeCtx* ctx, RuntimeInstr* instr)
 				RuntimeVar* newRet = p1.var->CallOperator(ERuntimeCallType::CompareEq, ctx, this, p2.var);
 				if (newRet) {
 					if (newRet->data.i64) {
-						newRet->data.i64 = 0;
-						this->SetLocal(ctx, bret, newRet);
+						this->ReturnVar(ctx, newRet);
+						this->WriteInt64(ctx, bret, 0);
 						fail = false;
 					}
 					else {
 						this->ReturnVar(ctx, newRet);
 						RuntimeVar* newRet = p1.var->CallOperator(ERuntimeCallType::CompareLess, ctx, this, p2.var);
 						if (newRet) {
-							newRet->data.i64 = !newRet->data.i64;
-							this->SetLocal(ctx, bret, newRet);
+							bool greater = !newRet->data.i64;
+							this->ReturnVar(ctx, newRet);
+							this->WriteInt64(ctx, bret, greater);
 							fail = false;
 						}
 					}
@@ -488,8 +1057,9 @@ RuntimeVar* RuntimeExecutor::ExecuteInstr(RuntimeCtx* ctx, RuntimeInstr* instr)
 						this->ReturnVar(ctx, newRet);
 						RuntimeVar* newRet = p1.var->CallOperator(ERuntimeCallType::CompareLess, ctx, this, p2.var);
 						if (newRet) {
-							newRet->data.i64 = !newRet->data.i64;
-							this->SetLocal(ctx, bret, newRet);
+							bool greaterEq = !newRet->data.i64;
+							this->ReturnVar(ctx, newRet);
+							this->WriteInt64(ctx, bret, greaterEq);
 							fail = false;
 						}
 					}
@@ -498,16 +1068,28 @@ RuntimeVar* RuntimeExecutor::ExecuteInstr(RuntimeCtx* ctx, RuntimeInstr* instr)
 					this->SetError("Illegal operation: " + p1.var->GetType()->GetName() + " >= " + p2.var->GetType()->GetName());
 				}
 			}
+            else if (callType == ERuntimeCallType::ArrayAccess) {
+                if (!p1.var->GetType()->HasOperator(callType)) {
+                    this->SetError("Invalid operator for type " + p1.var->GetType()->GetName() + ": " + ERuntimeCallType_ToString(callType));
+                    return nullptr;
+                }
+                RuntimeVar* newRet = p1.var->CallOperator(callType, ctx, this, p2.var);
+                if (newRet) {
+                    if (p1.var->GetType()->GetTypeEnum() == ERuntimeType::Array)
+                        this->BorrowLocal(ctx, bret, newRet); // element stays owned by the array
+                    else
+                        this->SetLocal(ctx, bret, newRet);
+                }
+            }
             else if(callType == ERuntimeCallType::Or){
-                RuntimeVar* ret = this->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-                ret->data.i64 = !p1.var->IsFalse() || !p2.var->IsFalse();
-                this->SetLocal(ctx, bret, ret);
+                this->WriteInt64(ctx, bret, !p1.var->IsFalse() || !p2.var->IsFalse());
             }
             else if(callType == ERuntimeCallType::And){
-                RuntimeVar* ret = this->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Int64));
-                ret->data.i64 = !p1.var->IsFalse() && !p2.var->IsFalse();
-                this->SetLocal(ctx, bret, ret);
+                this->WriteInt64(ctx, bret, !p1.var->IsFalse() && !p2.var->IsFalse());
             }
+			else if (!ret.borrowed && ScalarArithmetic(ctx, callType, p1.var, p2.var, ret.var)) {
+				// Int64/Double result written in place
+			}
 			else {
 				RuntimeVar* newRet = p1.var->CallOperator(callType, ctx, this, p2.var);
 				if (newRet) this->SetLocal(ctx, bret, newRet);
@@ -519,14 +1101,22 @@ RuntimeVar* RuntimeExecutor::ExecuteInstr(RuntimeCtx* ctx, RuntimeInstr* instr)
 		LocalVarState local = this->GetLocal(ctx, bret);
 
 		auto& methodName = instr->GetParam<std::string>(1);
-		RuntimeParamPack params;
-		for (size_t i = 2; i < instr->GetParamCount(); ++i) {
-			params.vars.push_back(this->GetLocal(ctx, instr->GetParam<std::string>(i)).var);
+		// arguments live in this frame, the heap is only touched for unusually long argument lists
+		const size_t argc = instr->GetParamCount() - 2;
+		RuntimeVar* inlineArgs[8];
+		std::vector<RuntimeVar*> heapArgs;
+		RuntimeVar** args = inlineArgs;
+		if (argc > std::size(inlineArgs)) {
+			heapArgs.resize(argc);
+			args = heapArgs.data();
+		}
+		for (size_t i = 0; i < argc; ++i) {
+			args[i] = this->GetLocal(ctx, instr->GetParam<std::string>(i + 2)).var;
 		}
 
 		REG nextIp = this->ip;
 
-		RuntimeVar* ret = this->CallMethod(ctx, ctx->GetMethod(methodName), params);
+		RuntimeVar* ret = this->CallMethod(ctx, ctx->GetMethod(methodName), RuntimeArgs(args, argc));
 
 		//if (local.var->heldType->GetTypeEnum() != ERuntimeType::Null) local.var->NativeTypeConvert(ctx->GetType(ERuntimeType::Null)); // destroy existing
 		this->SetLocal(ctx, bret, ret);
@@ -540,9 +1130,7 @@ RuntimeVar* RuntimeExecutor::ExecuteInstr(RuntimeCtx* ctx, RuntimeInstr* instr)
             local.var->NativeTypeConvert(ctx->GetType(ERuntimeType::Null)); // reset var so we don't convert
 
         local.var->NativeTypeConvert(ctx->GetType(ERuntimeType::Array));
-        ByteStream stream;
-        stream.Write<int64_t>(instr->GetParamCount() - 1);
-        local.var->NativeCtor(stream);
+        local.var->ConstructInt(instr->GetParamCount() - 1);
 
         for(size_t i = 1; i < instr->GetParamCount(); ++i){
             auto& bret = instr->GetParam<std::string>(i);
@@ -560,6 +1148,52 @@ RuntimeVar* RuntimeExecutor::ExecuteInstr(RuntimeCtx* ctx, RuntimeInstr* instr)
 			this->ip += instr->GetParam<int64_t>(0);
 		}
 	}
+	else if (instr->opcode == RuntimeInstrType::Switch) {
+		RuntimeVar* value = this->GetLocal(ctx, instr->GetParam<std::string>(1)).var;
+		this->ip += instr->GetParam<RuntimeSwitchTable>(2).Find(value, instr->GetParam<int64_t>(0));
+	}
+	else if (instr->opcode == RuntimeInstrType::Jnz) {
+		LocalVarState state = this->GetLocal(ctx, instr->GetParam<std::string>(1));
+		if (!state.var->IsFalse()) {
+			this->ip += instr->GetParam<int64_t>(0);
+		}
+	}
+	else if (instr->opcode == RuntimeInstrType::Test) {
+		// the result of && and || is overwritten in place
+		bool value = !this->GetLocal(ctx, instr->GetParam<std::string>(1)).var->IsFalse();
+		this->WriteInt64(ctx, instr->GetParam<std::string>(0), value);
+	}
+	else if (instr->opcode == RuntimeInstrType::Len) {
+		RuntimeVar* value = this->GetLocal(ctx, instr->GetParam<std::string>(1)).var;
+		if (value->GetType()->HasLen())
+			this->WriteInt64(ctx, instr->GetParam<std::string>(0), value->GetType()->Len(value));
+		else
+			this->SetError("Failed to len(), invalid type " + value->GetType()->GetName() + ", it has no length");
+	}
+	else if (instr->opcode == RuntimeInstrType::Append) {
+		RuntimeVar* array = this->GetLocal(ctx, instr->GetParam<std::string>(1)).var;
+		if (array->GetType()->GetTypeEnum() != ERuntimeType::Array) {
+			this->SetError("Failed to append, first argument should be array");
+			return nullptr;
+		}
+		array->CallOperator(ERuntimeCallType::ArrayAppend, ctx, this, this->GetLocal(ctx, instr->GetParam<std::string>(2)).var);
+		RuntimeVar* ret = this->GetLocal(ctx, instr->GetParam<std::string>(0)).var;
+		if (ret->GetType()->GetTypeEnum() != ERuntimeType::Null)
+			ret->NativeTypeConvert(ctx->GetType(ERuntimeType::Null));
+	}
+	else if (instr->opcode == RuntimeInstrType::ToInt) {
+		RuntimeVar* value = this->GetLocal(ctx, instr->GetParam<std::string>(1)).var;
+		if (value->GetType()->GetTypeEnum() != ERuntimeType::String) {
+			this->SetError("Failed to convert to int");
+			return nullptr;
+		}
+		try {
+			this->WriteInt64(ctx, instr->GetParam<std::string>(0), std::stoll(std::string(value->data.str.ptr, value->data.str.size)));
+		}
+		catch (...) {
+			this->SetError("Failed to convert to int");
+		}
+	}
 	else if (instr->opcode == RuntimeInstrType::Jge) {
 		auto& bcond = instr->GetParam<std::string>(1);
 		LocalVarState p2 = this->GetLocal(ctx, bcond);
@@ -585,6 +1219,36 @@ RuntimeVar* RuntimeExecutor::ExecuteInstr(RuntimeCtx* ctx, RuntimeInstr* instr)
 			//this->SetError("Illegal operation: " + p1.var->GetType()->GetName() + " >= " + p2.var->GetType()->GetName());
 		}
 	}
+	else if (instr->opcode == RuntimeInstrType::RangeInit) {
+		LocalVarState range = this->GetLocal(ctx, instr->GetParam<std::string>(1));
+		if (range.var->GetType()->GetTypeEnum() != ERuntimeType::Range) {
+			this->SetError("for: range expected, got " + range.var->GetType()->GetName());
+			return nullptr;
+		}
+		LocalVarState itr = this->GetLocal(ctx, instr->GetParam<std::string>(0));
+		if (itr.var->GetType()->GetTypeEnum() != ERuntimeType::Int64) {
+			itr.var->NativeTypeConvert(ctx->GetType(ERuntimeType::Null));
+			itr.var->NativeTypeConvert(ctx->GetType(ERuntimeType::Int64));
+		}
+		itr.var->data.i64 = static_cast<RuntimeRange*>(range.var->data.custom.dataBlob)->start;
+	}
+	else if (instr->opcode == RuntimeInstrType::RangeNext) {
+		// induction step stays in native Int64: no operator dispatch and no pool traffic per iteration
+		const RuntimeRange* range = static_cast<RuntimeRange*>(this->GetLocal(ctx, instr->GetParam<std::string>(1)).var->data.custom.dataBlob);
+		RuntimeVar* itr = this->GetLocal(ctx, instr->GetParam<std::string>(2)).var;
+		int64_t cur = itr->data.i64;
+		if (range->step > 0 ? cur >= range->stop : cur <= range->stop) {
+			this->ip += instr->GetParam<int64_t>(0);
+			return nullptr;
+		}
+		RuntimeVar* target = this->GetLocal(ctx, instr->GetParam<std::string>(3)).var;
+		if (target->GetType()->GetTypeEnum() != ERuntimeType::Int64) {
+			target->NativeTypeConvert(ctx->GetType(ERuntimeType::Null));
+			target->NativeTypeConvert(ctx->GetType(ERuntimeType::Int64));
+		}
+		target->data.i64 = cur;
+		itr->data.i64 = range->Next(cur);
+	}
 	else if (instr->opcode == RuntimeInstrType::Jmp) {
 		this->ip += instr->GetParam<int64_t>(0);
 	}
@@ -594,24 +1258,61 @@ RuntimeVar* RuntimeExecutor::ExecuteInstr(RuntimeCtx* ctx, RuntimeInstr* instr)
 		return state.var;
 	}
     else if(instr->opcode == RuntimeInstrType::ArrayAccess){
-
+        auto& bret = instr->GetParam<std::string>(0);
+        this->GetLocal(ctx, bret);
+        LocalVarState array = this->GetLocal(ctx, instr->GetParam<std::string>(1));
+        LocalVarState idx = this->GetLocal(ctx, instr->GetParam<std::string>(2));
+        if (array.var->GetType()->GetTypeEnum() == ERuntimeType::Array) {
+            this->BorrowLocal(ctx, bret, array.var->data.arr.data[idx.var->data.i64]);
+        }
+        else if (array.var->GetType()->HasOperator(ERuntimeCallType::ArrayAccess)) {
+            RuntimeVar* newRet = array.var->CallOperator(ERuntimeCallType::ArrayAccess, ctx, this, idx.var);
+            if (newRet) this->SetLocal(ctx, bret, newRet);
+        }
+        else {
+            this->SetError("Invalid operator for type " + array.var->GetType()->GetName() + ": " + ERuntimeCallType_ToString(ERuntimeCallType::ArrayAccess));
+        }
     }
 
 	return nullptr;
 }
 
-RuntimeVar* RuntimeExecutor::CallMethod(RuntimeCtx* ctx, RuntimeMethod* method, const RuntimeParamPack& params) {
+RuntimeVar* RuntimeExecutor::CallMethod(RuntimeCtx* ctx, RuntimeMethod* method, RuntimeArgs params) {
 	if (method->IsNative()) {
 		return method->NativeCall(ctx, this, params); // can be unnamed, later moved to scope in Ret
 	}
 
+	ByteWriter memoKey;
+	bool memo = method->IsMemoized() && method->MakeMemoKey(params, memoKey);
+	if (memo) {
+		if (RuntimeVar* cached = method->FindMemo(memoKey.View())) {
+			RuntimeVar* ret = this->CreateVar(ctx);
+			ret->CopyFrom(ctx, this, cached);
+			return ret;
+		}
+	}
+
+	if (this->limits.depth && this->depth >= this->limits.depth) {
+		this->SetError("Call depth limit exceeded: " + std::to_string(this->limits.depth));
+		return nullptr;
+	}
+	this->depth += 1;
+	// arguments from outside the executor have no scope holding them
+	size_t pinnedBefore = this->pinned.size();
+	if (this->depth == 1)
+		this->pinned.insert(this->pinned.end(), params.begin(), params.end());
+
 	LocalScope* oldScope = this->currentScope;
+	if (oldScope)
+		this->scopeStack.push_back(oldScope);
 	this->currentScope = new LocalScope();
+	if (uint32_t slots = method->GetFrameSlots())
+		this->currentScope->slots = this->region.Push(ctx, slots);
 	// push params
 	auto& names = method->GetParamNames();
 	for (size_t i = 0; i < method->GetParamCount(); ++i) {
 		auto state = this->GetLocal(ctx, names[i]);
-		state.var->CopyFrom(ctx, this, params.vars[i]);
+		state.var->CopyFrom(ctx, this, params[i]);
 		//this->currentScope->SetLocal(this, ctx, names[i], state.var, true); -- pass as reference
 	}
 
@@ -619,6 +1320,20 @@ RuntimeVar* RuntimeExecutor::CallMethod(RuntimeCtx* ctx, RuntimeMethod* method,
 	// scripted
 	RuntimeVar* returnVar = nullptr;
 	while (!this->isErrored) {
+		if (this->limits.steps && ++this->steps > this->limits.steps) {
+			this->SetError("Step limit exceeded: " + std::to_string(this->limits.steps));
+			break;
+		}
+		// safepoint: every live var is reachable from a scope, a pin or a memo cache
+		if (this->liveVars >= this->gcTrigger)
+			this->gcTrigger = this->collector->Step(ctx);
+		if (this->limits.bytes && this->memory.bytes > this->limits.bytes) {
+			// garbage counts against the limit until it is swept, so collect before giving up
+			if (this->collector->GetPolicy().mode != EGcMode::Off)
+				this->CollectGarbage(ctx);
+			if (!this->ReserveBytes(0))
+				break;
+		}
 		RuntimeInstr* instr = ctx->GetInstr(this->ip);
 		this->ip += 1;
 
@@ -634,36 +1349,118 @@ RuntimeVar* RuntimeExecutor::CallMethod(RuntimeCtx* ctx, RuntimeMethod* method,
 		retCopy->CopyFrom(ctx, this, returnVar);
 		returnVar = retCopy;
 	}
+	if (memo && returnVar && !this->isErrored) {
+		RuntimeVar* cached = this->CreateVar(ctx);
+		cached->CopyFrom(ctx, this, returnVar);
+		method->AddMemo(memoKey.View(), cached);
+	}
 
 	if (oldScope) {
 		this->currentScope->Destroy(this, ctx);
+		if (this->currentScope->slots)
+			this->region.Pop(ctx, this->currentScope->slots);
 		delete this->currentScope;
 		this->currentScope = oldScope;
+		this->scopeStack.pop_back();
 	} // don't destroy last scope so we can see main return value
+	this->pinned.resize(pinnedBefore);
+	this->depth -= 1;
 	return returnVar;
 }
+// type tag followed by the value bytes; Custom types have no value semantics and are not cached
+static bool WriteMemoKey(RuntimeVar* var, ByteWriter& key) {
+	ERuntimeType type = var->GetType()->GetTypeEnum();
+	key.Write(static_cast<uint8_t>(type));
+	switch (type) {
+	case ERuntimeType::Null:
+		return true;
+	case ERuntimeType::Int64:
+		key.Write(var->data.i64);
+		return true;
+	case ERuntimeType::Double:
+		key.Write(var->data.dbl);
+		return true;
+	case ERuntimeType::String:
+		key.Write(std::string_view(var->data.str.ptr, var->data.str.size));
+		return true;
+	case ERuntimeType::Array:
+		key.Write(var->data.arr.size);
+		for (uint32_t i = 0; i < var->data.arr.size; ++i) {
+			if (!WriteMemoKey(var->data.arr.data[i], key))
+				return false;
+		}
+		return true;
+	case ERuntimeType::Range:
+		key.Write(*static_cast<RuntimeRange*>(var->data.custom.dataBlob));
+		return true;
+	case ERuntimeType::Bitset: {
+		const RuntimeBitset* bits = static_cast<RuntimeBitset*>(var->data.custom.dataBlob);
+		key.Write(bits->Size());
+		for (uint64_t word : bits->GetWords()) {
+			key.Write(word);
+		}
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+bool RuntimeMethod::MakeMemoKey(RuntimeArgs params, ByteWriter& key) {
+	key.Reserve(params.size() * (1 + sizeof(int64_t)));
+	for (RuntimeVar* param : params) {
+		if (!WriteMemoKey(param, key))
+			return false;
+	}
+	return true;
+}
+
+RuntimeVar* RuntimeMethod::FindMemo(std::string_view key) {
+	auto it = this->memoCache.find(key);
+	if (it == this->memoCache.end()) {
+		this->memoMisses += 1;
+		return nullptr;
+	}
+	this->memoHits += 1;
+	return it->second;
+}
+
 void RuntimeExecutor::SetError(std::string errorMessage) {
 	this->isErrored = true;
 	this->errorMessage = errorMessage;
 }
 
 RuntimeCtx::RuntimeCtx() {
+	this->optLevel = EOptLevel::O2;
+	this->autoMemo = false;
 	this->executor = new RuntimeExecutor();
 	Precompile::CreateTypes(this);
 
 	// set default
-	this->defaultTypes[(int)ERuntimeType::Int64] = this->GetType(Hash{}("Int64"));
-	this->defaultTypes[(int)ERuntimeType::String] = this->GetType(Hash{}("String"));
-	this->defaultTypes[(int)ERuntimeType::Null] = this->GetType(Hash{}("Null"));
-	this->defaultTypes[(int)ERuntimeType::Array] = this->GetType(Hash{}("Array"));
-	this->defaultTypes[(int)ERuntimeType::Double] = this->GetType(Hash{}("Double"));
+	for (int i = 0; i < (int)ERuntimeType::DEFAULT_MAX; ++i) {
+		this->defaultTypes[i] = this->GetType(Hash{}(ERuntimeType_ToString((ERuntimeType)i)));
+	}
+
+	this->smallInts.resize(maxSmallInt - minSmallInt + 1);
+	for (int64_t value = minSmallInt; value <= maxSmallInt; ++value) {
+		RuntimeVar& var = this->smallInts[value - minSmallInt];
+		var.SetType(this->GetType(ERuntimeType::Int64));
+		var.data.i64 = value;
+	}
 
 }
 RuntimeCtx::~RuntimeCtx() {
 	if (this->executor) {
+		this->executor->ReleaseVars(this);
 		delete this->executor;
 		this->executor = nullptr;
 	}
+	for (auto& [h, method] : this->regMethods) {
+		delete method;
+	}
+	for (auto& [tid, type] : this->regTypes) {
+		delete type;
+	}
 }
 
 RuntimeMethod* RuntimeCtx::GetMethod(HashType methodName) {
@@ -694,6 +1491,7 @@ void RuntimeCtx::AddPoliz(Parser* parser, Poliz* root) {
 			continue; // don't override
 		}
 		RuntimeMethod* method = new RuntimeMethod(func.name, func.argNames);
+		method->SetMemoRequested(func.memo);
 		this->regMethods[Hash{}(func.name)] = method;
 	}
 
@@ -704,6 +1502,19 @@ void RuntimeCtx::AddPoliz(Parser* parser, Poliz* root) {
 		method->FromPoliz(this, pz.poliz);
 		std::cout << std::endl;
 	}
+
+	Optimizer::AnalyzePurity(this);
+	if (this->optLevel >= EOptLevel::O1)
+		Optimizer::FoldConstantCalls(this);
+	for (auto& [h, method] : this->regMethods) {
+		if (method->IsNative() || !(method->IsMemoRequested() || this->autoMemo))
+			continue;
+		if (method->IsPure())
+			method->SetMemoized(true);
+		else if (method->IsMemoRequested())
+			std::cerr << "memo ignored for " << method->GetName() << ": not pure" << std::endl;
+	}
+	Optimizer::AllocateFrameSlots(this);
 }
 
 int64_t RuntimeCtx::ExecuteRoot(std::string functionName) {
@@ -712,7 +1523,7 @@ int64_t RuntimeCtx::ExecuteRoot(std::string functionName) {
 		return 1;
 	}
 	this->executor->Reset();
-	RuntimeVar* ret = this->executor->CallMethod(this, method, RuntimeParamPack());
+	RuntimeVar* ret = this->executor->CallMethod(this, method, {});
 	if (!ret) {
 		return 1;
 	}
@@ -737,6 +1548,7 @@ void RuntimeCtx::AddMethod(RuntimeMethod* method) {
 
 RuntimeInstr* RuntimeCtx::AllocateFunction(RuntimeMethod* method, size_t size) {
 	method->SetVA(this->instrHolder.size());
+	method->SetCodeSize(size);
 	this->instrHolder.resize(this->instrHolder.size() + size);
 	return &this->instrHolder[this->instrHolder.size() - size];
 }
@@ -744,28 +1556,32 @@ RuntimeInstr* RuntimeCtx::GetInstr(REG idx) {
 	return &this->instrHolder[idx];
 }
 
+void RuntimeVar::ConstructFrom(RuntimeCtx* ctx, const RuntimeInstr& ctor) {
+	this->NativeTypeConvert(ctx->GetType(ctor.GetParam<TID>(1)));
+
+	switch (this->heldType->GetTypeEnum()) {
+	case ERuntimeType::Int64:
+		this->ConstructInt(ctor.GetParam<int64_t>(2));
+		break;
+	case ERuntimeType::Double:
+		this->ConstructDouble(ctor.GetParam<double>(2));
+		break;
+	case ERuntimeType::String: {
+		auto& str = ctor.GetParam<std::string>(2);
+		this->ConstructString(str.data(), str.size());
+		break;
+	}
+	default: // Null carries no value
+		break;
+	}
+}
+
 void RuntimeVar::CopyFrom(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* other){
     assert(this->heldType->GetTypeEnum() == ERuntimeType::Null);
 
     this->heldType = other->heldType;
-    if (other->heldType->GetTypeEnum() == ERuntimeType::String) {
-        ByteStream stream;
-        stream.Write(std::string(other->data.str.ptr, other->data.str.ptr + other->data.str.size));
-        this->NativeCtor(stream);
-    }
-    else if (other->heldType->GetTypeEnum() == ERuntimeType::Array) {
-        ByteStream stream;
-        stream.Write(other->data.arr.cap);
-        this->NativeCtor(stream);
-        for(size_t i = 0; i < other->data.arr.size; ++i){
-            RuntimeVar* cp = exec->CreateVar(ctx);
-            cp->CopyFrom(ctx, exec, other->data.arr.data[i]);
-            this->data.arr.data[i] = cp;
-        }
-        this->data.arr.size = other->data.arr.size;
-        // copy Array
-    }
-    else {
+    if (this->heldType->HasCopy())
+        this->heldType->Copy(ctx, exec, this, other);
+    else
         this->data = other->data;
-    }
-}
\ No newline at end of file
+}
@@ -10,7 +10,10 @@
 #include <set>
 #include <any>
 #include <cassert>
-#include <list>
+#include <cstring>
+#include <string_view>
+#include <span>
+#include <tuple>
 
 #include "Poliz.h"
 
@@ -23,6 +26,11 @@ using Hash = std::hash<std::string>;
 using HashType = decltype(Hash{}(""));
 #define INVALID_REG_VALUE ((uint64_t)-1)
 
+// 128-bit vector paths of the native containers; x86-64 always has SSE2, other targets take the scalar loops
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RUNTIME_SSE2
+#endif
+
 enum class ERuntimeCallType {
 	Invalid,
 
@@ -132,6 +140,17 @@ class RuntimeMethod;
 class RuntimeExecutor;
 class RuntimeVar;
 class RuntimeCtx;
+class RuntimeDict;
+class RuntimeBitset;
+class RuntimeHeap;
+class RuntimeDeque;
+class RuntimeSortedMap;
+
+enum class EOptLevel {
+	O0, // lowering only
+	O1, // bounds checks, value numbering, dead stores
+	O2, // + loop-invariant code motion
+};
 
 enum class ERuntimeType {
 	Null,
@@ -140,85 +159,174 @@ enum class ERuntimeType {
 	Double,
 	String,
 	Array,
+	Range,
+	Dict,
+	Bitset,
+	Heap,
+	Deque,
+	SortedMap,
 
 	Custom,
 	DEFAULT_MAX = Custom,
 };
 
-struct ByteStream {
-private:
-	std::vector<uint8_t> bf_write;
-	uint32_t offset;
-
-	inline void Write(const void* data, size_t dt) {
-		bf_write.insert(bf_write.cend(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + dt);
+// the name the type registers under
+constexpr const char* ERuntimeType_ToString(ERuntimeType type) {
+	switch (type) {
+	case ERuntimeType::Null: return "Null";
+	case ERuntimeType::Int64: return "Int64";
+	case ERuntimeType::Double: return "Double";
+	case ERuntimeType::String: return "String";
+	case ERuntimeType::Array: return "Array";
+	case ERuntimeType::Range: return "Range";
+	case ERuntimeType::Dict: return "Dict";
+	case ERuntimeType::Bitset: return "Bitset";
+	case ERuntimeType::Heap: return "Heap";
+	case ERuntimeType::Deque: return "Deque";
+	case ERuntimeType::SortedMap: return "SortedMap";
+	default: return "Custom";
 	}
+}
 
-	inline void Read(void* data, size_t dt) {
-		std::copy(bf_write.data() + this->offset, bf_write.data() + this->offset + dt, (uint8_t*)data);
-		this->offset += dt;
-	}
+// lets string-keyed maps be searched with a string_view
+struct RuntimeStringHash {
+	using is_transparent = void;
+	size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+};
 
-public:
-	ByteStream() : offset(0) {}
-	ByteStream(const std::vector<uint8_t>& st) : offset(0), bf_write(st) {}
+// Binary encoding: trivially copyable values are stored as their bytes, strings as a size_t length followed by the
+// characters. ByteWriter appends, ByteStream reads it back without copying.
+struct ByteWriter {
+private:
+	std::vector<uint8_t> buffer;
 
-	const std::vector<uint8_t>& GetBuffer() { return this->bf_write; }
+public:
+	void Reserve(size_t size) { this->buffer.reserve(size); }
+	void Clear() { this->buffer.clear(); }
+	size_t GetSize() const { return this->buffer.size(); }
+	const std::vector<uint8_t>& GetBuffer() const { return this->buffer; }
+	std::vector<uint8_t> Release() { return std::move(this->buffer); }
+	// the encoded bytes, e.g. as a hash map key
+	std::string_view View() const { return std::string_view(reinterpret_cast<const char*>(this->buffer.data()), this->buffer.size()); }
 
-	inline void Write(std::string val) {
-		size_t sz = val.size();
-		this->Write(&sz, sizeof(sz));
-		this->Write(val.data(), sz);
+	inline void WriteBytes(const void* data, size_t size) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		this->buffer.insert(this->buffer.end(), bytes, bytes + size);
 	}
-	inline void Write(const std::vector<uint8_t>& val) {
-		bf_write.insert(bf_write.begin(), val.begin(), val.end());
+	inline void Write(std::string_view val) {
+		this->Write<size_t>(val.size());
+		this->WriteBytes(val.data(), val.size());
+	}
+	inline void Write(const std::string& val) {
+		this->Write(std::string_view(val));
+	}
+	inline void Write(const char* val) {
+		this->Write(std::string_view(val));
 	}
-
 	template<typename T>
-	inline void Write(const T& val) requires std::is_trivially_copyable_v<T>  {
-		this->Write(&val, sizeof(val));
+	inline void Write(const T& val) requires std::is_trivially_copyable_v<T> {
+		this->WriteBytes(&val, sizeof(val));
 	}
+};
 
-	template<typename T>
-	inline const T& Read() requires std::is_trivially_copyable_v<T>  {
-		T val{};
-		this->Read(&val, sizeof(val));
-		return val;
+// Non-owning reader over encoded bytes, which must outlive the stream and any string_view read from it.
+// Reading past the end yields zero values and empty strings and marks the stream failed.
+struct ByteStream {
+private:
+	std::span<const uint8_t> data;
+	size_t offset;
+	bool failed;
+
+	inline const uint8_t* Take(size_t size) {
+		if (this->failed || size > this->data.size() - this->offset) {
+			this->failed = true;
+			return nullptr;
+		}
+		const uint8_t* ptr = this->data.data() + this->offset;
+		this->offset += size;
+		return ptr;
 	}
 
+public:
+	ByteStream(std::span<const uint8_t> data_) : data(data_), offset(0), failed(false) {}
+
+	bool IsFailed() const { return this->failed; }
+	bool IsEnd() const { return this->offset == this->data.size(); }
+	size_t GetRemaining() const { return this->data.size() - this->offset; }
+
 	template<typename T>
-	inline std::string Read() {
-		std::string val;
-		size_t ln = this->Read<size_t>();
-		val.reserve(ln);
-		size_t rd = 0;
-		while (rd < ln) {
-			char chunk[128];
-			size_t pr = std::min(ln - rd, sizeof chunk);
-			this->Read(chunk, pr);
-			val.insert(val.begin(), chunk, chunk + pr);
-			rd += pr;
-		}
+	inline T Read() requires std::is_trivially_copyable_v<T> {
+		T val{};
+		if (const uint8_t* ptr = this->Take(sizeof(val)))
+			memcpy(&val, ptr, sizeof(val));
 		return val;
 	}
+	inline std::string_view ReadString() {
+		size_t size = this->Read<size_t>();
+		const uint8_t* ptr = this->Take(size);
+		return ptr ? std::string_view(reinterpret_cast<const char*>(ptr), size) : std::string_view();
+	}
+	inline std::span<const uint8_t> ReadBytes(size_t size) {
+		const uint8_t* ptr = this->Take(size);
+		return ptr ? std::span<const uint8_t>(ptr, size) : std::span<const uint8_t>();
+	}
 };
 
 
-struct RuntimeParamPack {
-	std::vector<RuntimeVar*> vars;
+// lazy integer sequence held by Range vars, iterated without materializing an array
+struct RuntimeRange {
+	int64_t start;
+	int64_t stop;
+	int64_t step;
+
+	// distances and strides are unsigned, so ranges reaching the ends of Int64 neither overflow nor wrap
+	uint64_t Count() const {
+		if (this->step > 0 && this->start < this->stop)
+			return ((uint64_t)this->stop - (uint64_t)this->start - 1) / this->Stride() + 1;
+		if (this->step < 0 && this->start > this->stop)
+			return ((uint64_t)this->start - (uint64_t)this->stop - 1) / this->Stride() + 1;
+		return 0;
+	}
+	// range() rejects ranges longer than Int64 can count
+	int64_t Size() const { return (int64_t)this->Count(); }
+	int64_t At(int64_t idx) const {
+		return (int64_t)((uint64_t)this->start + (uint64_t)idx * (uint64_t)this->step);
+	}
+	uint64_t Stride() const { return this->step > 0 ? (uint64_t)this->step : 0 - (uint64_t)this->step; }
+	// value after cur, or stop once the step would carry past it
+	int64_t Next(int64_t cur) const {
+		uint64_t left = this->step > 0 ? (uint64_t)this->stop - (uint64_t)cur : (uint64_t)cur - (uint64_t)this->stop;
+		return this->Stride() >= left ? this->stop : (int64_t)((uint64_t)cur + (uint64_t)this->step);
+	}
 };
+
+// call arguments, viewed in place: a buffer in the caller's frame for Call, any vector otherwise
+using RuntimeArgs = std::span<RuntimeVar* const>;
 class RuntimeType {
 	friend class RuntimeVar;
 	using OpCallType = RuntimeVar*(*)(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p1, RuntimeVar* p2);
+	// typed constructors fill a var that already holds this type with its default (empty) value
+	using IntCtorType = void(*)(RuntimeVar* var, int64_t value);
+	using DoubleCtorType = void(*)(RuntimeVar* var, double value);
+	using StringCtorType = void(*)(RuntimeVar* var, const char* ptr, size_t size);
+	using TypeConvertType = bool(*)(RuntimeVar* var, RuntimeType* desType);
+	using IsFalseType = bool(*)(RuntimeVar* var);
+	using LenType = int64_t(*)(RuntimeVar* var);
+	// fills dst, which already holds this type, with a deep copy of src
+	using CopyType = void(*)(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* dst, RuntimeVar* src);
 private:
 	std::string name;
 	TID id;
 	ERuntimeType type;
 	uint32_t size;
 
-	std::function<void(RuntimeVar*, ByteStream&)> nativeCtor;
-	std::function<bool(RuntimeVar*, RuntimeType*)> nativeTypeConvert;
-	std::function<bool(RuntimeVar*)> nativeIsFalse;
+	IntCtorType intCtor;
+	DoubleCtorType doubleCtor;
+	StringCtorType stringCtor;
+	TypeConvertType nativeTypeConvert;
+	IsFalseType nativeIsFalse;
+	LenType nativeLen;
+	CopyType nativeCopy;
 	std::array<OpCallType, static_cast<int>(ERuntimeCallType::MAX)> vtable;
 
 	bool NativeTypeConvert(RuntimeVar* var, RuntimeType* desType){
@@ -233,23 +341,42 @@ private:
 		return this->vtable[idx](ctx, exec, p1, p2);
 	}
 public:
-	void NativeCtor(RuntimeVar* var, const std::vector<uint8_t>& rawData) {
-		ByteStream stream(rawData);
-		return this->nativeCtor(var, stream);
+	void ConstructInt(RuntimeVar* var, int64_t value) {
+		assert(this->intCtor);
+		this->intCtor(var, value);
 	}
-	void NativeCtor(RuntimeVar* var, ByteStream& stream) {
-		return this->nativeCtor(var, stream);
+	void ConstructDouble(RuntimeVar* var, double value) {
+		assert(this->doubleCtor);
+		this->doubleCtor(var, value);
+	}
+	void ConstructString(RuntimeVar* var, const char* ptr, size_t size) {
+		assert(this->stringCtor);
+		this->stringCtor(var, ptr, size);
 	}
 
-	void SetNativeIsFalse(decltype(RuntimeType::nativeIsFalse) func) {
-		this->nativeIsFalse = func;
+	void SetIntCtor(IntCtorType func) {
+		this->intCtor = func;
 	}
-	void SetNativeCtor(decltype(RuntimeType::nativeCtor) func) {
-		this->nativeCtor = func;
+	void SetDoubleCtor(DoubleCtorType func) {
+		this->doubleCtor = func;
 	}
-	void SetNativeTypeConvert(decltype(RuntimeType::nativeTypeConvert) func) {
+	void SetStringCtor(StringCtorType func) {
+		this->stringCtor = func;
+	}
+	void SetNativeIsFalse(IsFalseType func) {
+		this->nativeIsFalse = func;
+	}
+	void SetNativeTypeConvert(TypeConvertType func) {
 		this->nativeTypeConvert = func;
 	}
+	// what len() returns; types without it have no length
+	void SetNativeLen(LenType func) {
+		this->nativeLen = func;
+	}
+	// types without it are copied bit for bit
+	void SetNativeCopy(CopyType func) {
+		this->nativeCopy = func;
+	}
 
     bool HasOperator(ERuntimeCallType type){
         return this->vtable[static_cast<int>(type)] != nullptr;
@@ -268,9 +395,21 @@ public:
 		return false;
 	}
 
-	bool IsNativeCtorable() {
-		return this->nativeCtor != nullptr;
+	bool HasLen() {
+		return this->nativeLen != nullptr;
+	}
+	int64_t Len(RuntimeVar* var) {
+		assert(this->nativeLen);
+		return this->nativeLen(var);
+	}
+	bool HasCopy() {
+		return this->nativeCopy != nullptr;
 	}
+	void Copy(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* dst, RuntimeVar* src) {
+		assert(this->nativeCopy);
+		this->nativeCopy(ctx, exec, dst, src);
+	}
+
 	TID GetTID() {
 		return this->id;
 	}
@@ -282,14 +421,20 @@ public:
 	}
 
 	RuntimeType(const std::string& name_, ERuntimeType type_, uint32_t size_) : size(size_), name(name_), id(std::hash<std::string>{}(name)), type(type_) {
-		this->nativeCtor = nullptr;
+		this->intCtor = nullptr;
+		this->doubleCtor = nullptr;
+		this->stringCtor = nullptr;
         this->nativeTypeConvert = nullptr;
+		this->nativeIsFalse = nullptr;
+		this->nativeLen = nullptr;
+		this->nativeCopy = nullptr;
 		vtable.fill(0);
 	}
 };
 
 class RuntimeExecutor;
 class RuntimeCtx;
+struct RuntimeInstr;
 class RuntimeVar {
 	RuntimeType* heldType;
 public:
@@ -323,11 +468,15 @@ public:
         }
         return false;
 	}
-	void NativeCtor(const std::vector<uint8_t>& rawData){
-		return this->heldType->NativeCtor(this, rawData);
+	void ConstructInt(int64_t value) {
+		this->heldType->ConstructInt(this, value);
+	}
+	void ConstructDouble(double value) {
+		this->heldType->ConstructDouble(this, value);
 	}
-	void NativeCtor(ByteStream& rawData) {
-		return this->heldType->NativeCtor(this, rawData);
+	// ptr may be null to allocate size bytes that the caller fills in place
+	void ConstructString(const char* ptr, size_t size) {
+		this->heldType->ConstructString(this, ptr, size);
 	}
 
 	RuntimeVar* CallOperator(ERuntimeCallType type, RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* p2) {
@@ -335,6 +484,8 @@ public:
 	}
 
 	void CopyFrom(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* other);
+	// builds the constant of a Ctor instruction into a Null var
+	void ConstructFrom(RuntimeCtx* ctx, const RuntimeInstr& ctor);
 
 
 	bool IsFalse() {
@@ -350,10 +501,10 @@ public:
 	}
 };
 
-using RuntimeMethodPtr = RuntimeVar*(*)(RuntimeCtx*, RuntimeExecutor*, const std::vector<RuntimeVar*>&);
+using RuntimeMethodPtr = RuntimeVar*(*)(RuntimeCtx*, RuntimeExecutor*, RuntimeArgs);
 class RuntimeMethod {
 public:
-	RuntimeMethod() : anyParams(false), va(INVALID_REG_VALUE), native(nullptr) {
+	RuntimeMethod() : anyParams(false), va(INVALID_REG_VALUE), codeSize(0), frameSlots(0), native(nullptr), pure(false), writesArgs(true), memoRequested(false), memoized(false), memoHits(0), memoMisses(0) {
 
 	}
 	RuntimeMethod(const std::string& name_, const std::vector<std::string>& params_) : RuntimeMethod() {
@@ -389,10 +540,43 @@ public:
 	void SetVA(REG va) {
 		this->va = va;
 	}
+	size_t GetCodeSize() {
+		return this->codeSize;
+	}
+	void SetCodeSize(size_t size) {
+		this->codeSize = size;
+	}
+	// temporaries renamed to `#n` by Optimizer::AllocateFrameSlots, each call takes them from the executor's VarRegion
+	uint32_t GetFrameSlots() {
+		return this->frameSlots;
+	}
+	void SetFrameSlots(uint32_t count) {
+		this->frameSlots = count;
+	}
+
+	// natives: no input or output, see Precompile::AddNative; script methods: Optimizer::AnalyzePurity
+	bool IsPure() { return this->pure; }
+	void SetPure(bool pure_) { this->pure = pure_; }
+	// natives: whether they may write the vars passed to them, set on registration; script methods get copies
+	bool WritesArgs() { return this->writesArgs; }
+	void SetWritesArgs(bool writes) { this->writesArgs = writes; }
+	// `memo function` in the script; only pure methods are actually memoized
+	bool IsMemoRequested() { return this->memoRequested; }
+	void SetMemoRequested(bool memo) { this->memoRequested = memo; }
+	bool IsMemoized() { return this->memoized; }
+	void SetMemoized(bool memo) { this->memoized = memo; }
+
+	// memo cache keyed by the serialized argument values, see MakeMemoKey
+	bool MakeMemoKey(RuntimeArgs params, ByteWriter& key);
+	RuntimeVar* FindMemo(std::string_view key);
+	void AddMemo(std::string_view key, RuntimeVar* result) { this->memoCache.insert_or_assign(std::string(key), result); }
+	const auto& GetMemoCache() { return this->memoCache; }
+	uint64_t GetMemoHits() { return this->memoHits; }
+	uint64_t GetMemoMisses() { return this->memoMisses; }
 
 	bool IsNative() { return this->native != nullptr; }
-	RuntimeVar* NativeCall(RuntimeCtx* ctx, RuntimeExecutor* exec, const RuntimeParamPack& params) {
-		return this->native(ctx, exec, params.vars);
+	RuntimeVar* NativeCall(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeArgs params) {
+		return this->native(ctx, exec, params);
 	}
 
 private:
@@ -402,6 +586,16 @@ private:
 
 	RuntimeMethodPtr native;
 	REG va;
+	size_t codeSize;
+	uint32_t frameSlots;
+
+	bool pure;
+	bool writesArgs;
+	bool memoRequested;
+	bool memoized;
+	std::unordered_map<std::string, RuntimeVar*, RuntimeStringHash, std::equal_to<>> memoCache; // results are owned by the cache
+	uint64_t memoHits;
+	uint64_t memoMisses;
 };
 
 enum class RuntimeInstrType {
@@ -413,11 +607,22 @@ enum class RuntimeInstrType {
 	Call, // Call [ret] [func] params...
 	Array, // Array [ret] params...
 	Jz, // Jz [delta] [var]
+	Jnz, // Jnz [delta] [var]
 	Jge, // Jge [delta] [var]
 	Jmp, // Jmp [delta]
 	Ret, // Ret [value]
     ArraySize, // ArraySize [ret] [array]
-    ArrayAccess, // ArrayAccess [ret] [idx] [idx]
+    ArrayAccess, // ArrayAccess [ret] [array] [idx] -- index proven in bounds by Optimizer
+	RangeInit, // RangeInit [itr] [range]
+	RangeNext, // RangeNext [delta] [range] [itr] [var]
+	Test, // Test [ret] [value] -- ret = Int64 0/1, written in place
+	Switch, // Switch [default delta] [value] [RuntimeSwitchTable]
+	Const, // Const [ret] [RuntimeVar*] -- ret = copy of a value computed at compile time
+
+	// builtins lowered from Call, results written in place
+	Len, // Len [ret] [value] -- len()
+	Append, // Append [ret] [array] [value] -- append()
+	ToInt, // ToInt [ret] [value] -- int()
 };
 inline std::string RuntimeInstrType_ToString(RuntimeInstrType c) {
 	switch (c) {
@@ -428,20 +633,46 @@ inline std::string RuntimeInstrType_ToString(RuntimeInstrType c) {
 	case RuntimeInstrType::Call: return "Call";
 	case RuntimeInstrType::Array: return "Array";
 	case RuntimeInstrType::Jz: return "Jz";
+	case RuntimeInstrType::Jnz: return "Jnz";
 	case RuntimeInstrType::Jge: return "Jge";
 	case RuntimeInstrType::Jmp: return "Jmp";
 	case RuntimeInstrType::Ret: return "Ret";
     case RuntimeInstrType::ArraySize: return "ArraySize";
+    case RuntimeInstrType::ArrayAccess: return "ArrayAccess";
+	case RuntimeInstrType::RangeInit: return "RangeInit";
+	case RuntimeInstrType::RangeNext: return "RangeNext";
+	case RuntimeInstrType::Test: return "Test";
+	case RuntimeInstrType::Switch: return "Switch";
+	case RuntimeInstrType::Const: return "Const";
+	case RuntimeInstrType::Len: return "Len";
+	case RuntimeInstrType::Append: return "Append";
+	case RuntimeInstrType::ToInt: return "ToInt";
 	}
 	return "";
 }
 
+// Case targets of a Switch. Slots hold jump deltas like param 0 of any jump, so they are rebased and rewritten
+// together with it.
+struct RuntimeSwitchTable {
+	std::vector<int64_t> deltas;
+	bool dense = false;
+	int64_t base = 0; // dense: Int64 value v takes slot v - base
+	std::unordered_map<int64_t, size_t> intSlots;
+	std::unordered_map<std::string, size_t, RuntimeStringHash, std::equal_to<>> stringSlots;
+
+	void AddCase(int64_t key, int64_t delta);
+	void AddCase(const std::string& key, int64_t delta);
+	// integer-only tables covering at least half of their key range become a direct jump table, holes take the default
+	void Compact(int64_t defaultDelta);
+	int64_t Find(RuntimeVar* value, int64_t defaultDelta) const;
+};
+
 struct RuntimeInstr {
 	RuntimeInstrType opcode;
 
 	template<typename T>
 	void AddParam(T param) {
-		static_assert(std::is_same_v<T, double> || std::is_same_v<T, std::string> || std::is_same_v<T, int64_t> || std::is_same_v<T, HashType> || std::is_same_v<T, TID> || std::is_same_v<T, ERuntimeCallType>);
+		static_assert(std::is_same_v<T, double> || std::is_same_v<T, std::string> || std::is_same_v<T, int64_t> || std::is_same_v<T, HashType> || std::is_same_v<T, TID> || std::is_same_v<T, ERuntimeCallType> || std::is_same_v<T, RuntimeSwitchTable> || std::is_same_v<T, RuntimeVar*>);
 		this->params.push_back(param);
 	}
 
@@ -461,6 +692,20 @@ struct RuntimeInstr {
 		return this->GetParam<std::string>(0);
 	}
 
+	// jumps keep their delta in param 0, relative to the next instruction; Switch has more in its table
+	bool IsJump() const {
+		return this->opcode == RuntimeInstrType::Jmp || this->opcode == RuntimeInstrType::Switch || this->IsConditionalJump();
+	}
+	std::vector<int64_t> GetJumpDeltas() const;
+	void SetJumpDeltas(const std::vector<int64_t>& deltas);
+	bool IsConditionalJump() const {
+		return this->opcode == RuntimeInstrType::Jz || this->opcode == RuntimeInstrType::Jnz || this->opcode == RuntimeInstrType::Jge ||
+			this->opcode == RuntimeInstrType::RangeNext;
+	}
+	std::vector<std::string> GetDefinedVars() const;
+	std::pair<size_t, size_t> GetUsedParams() const; // [first, last) params naming locals read by the instruction
+	std::vector<std::string> GetUsedVars() const;
+
 	std::string GetParamString(RuntimeCtx* ctx, size_t idx) const;
 	std::vector<uint8_t> GetRawParam(size_t idx) const;
 
@@ -484,9 +729,21 @@ public:
 	RuntimeMethod* GetMethod(std::string methodName) {
 		return this->GetMethod(Hash{}(methodName));
 	}
+	const std::map<HashType, RuntimeMethod*>& GetMethods() { return this->regMethods; }
 	RuntimeType* GetType(TID typeName);
 	RuntimeType* GetType(ERuntimeType typeEnum);
 
+	// Immortal Int64 values for booleans and small counts, shared by every executor of the context. They are only
+	// read: scopes copy them into their own vars and ReturnVar ignores them.
+	static constexpr int64_t minSmallInt = -128;
+	static constexpr int64_t maxSmallInt = 1023;
+	RuntimeVar* GetSmallInt(int64_t value) {
+		return value >= minSmallInt && value <= maxSmallInt ? &this->smallInts[value - minSmallInt] : nullptr;
+	}
+	bool IsImmortal(const RuntimeVar* var) const {
+		return var >= this->smallInts.data() && var < this->smallInts.data() + this->smallInts.size();
+	}
+
 	RuntimeInstr* GetInstr(REG idx);
 	RuntimeInstr* AllocateFunction(RuntimeMethod* method, size_t size);
 
@@ -495,56 +752,234 @@ public:
 
 	std::string GetErrorString();
 	size_t GetCodeSize() { return this->instrHolder.size(); }
+
+	void SetOptLevel(EOptLevel level) { this->optLevel = level; }
+	EOptLevel GetOptLevel() { return this->optLevel; }
+	// memoize every pure script method, not only the ones declared with `memo`
+	void SetAutoMemo(bool enable) { this->autoMemo = enable; }
+	bool IsAutoMemo() { return this->autoMemo; }
+	// optimization passes left out of the default pipeline, by PassManager name
+	void SetDisabledPasses(const std::set<std::string>& passes) { this->disabledPasses = passes; }
+	const std::set<std::string>& GetDisabledPasses() { return this->disabledPasses; }
 private:
 	std::map<HashType, RuntimeMethod*> regMethods;
 	std::map<TID, RuntimeType*> regTypes;
 	std::array<RuntimeType*, (int)ERuntimeType::DEFAULT_MAX> defaultTypes;
+	std::vector<RuntimeVar> smallInts; // minSmallInt..maxSmallInt
 	std::vector<RuntimeInstr> instrHolder;
+	EOptLevel optLevel;
+	bool autoMemo;
+	std::set<std::string> disabledPasses;
 
 	RuntimeExecutor* executor;
 };
 
 
-template<typename T>
-struct VarPool {
-	T* block;
-	int size;
-	std::list<T*> lst;
-	
-	VarPool() : block(nullptr), size(0) {}
-	inline VarPool(RuntimeCtx* ctx, int length){
-		this->block = new T[length];
-		this->size = length;
-		for(int i = 0; i < length; ++i){
-            RuntimeVar* var = this->block + i;
-            var->SetType(ctx->GetType(ERuntimeType::Null));
-			this->lst.push_back(var);
-		}
+// When VarPool hands chunks back: Manual only on Trim(), Eager as soon as a chunk's last var is returned.
+// Either way the pool keeps at least retainVars of capacity, so a loop around the boundary does not thrash.
+enum class EVarPoolTrim {
+	Manual,
+	Eager,
+};
+
+struct VarPoolPolicy {
+	EVarPoolTrim trim = EVarPoolTrim::Eager;
+	size_t retainVars = 64 * 1024; // high-water mark of capacity kept through trimming
+};
+
+struct VarPoolStats {
+	size_t capacity = 0;
+	size_t peakCapacity = 0;
+	size_t chunks = 0;
+	size_t live = 0;
+	size_t trimmedChunks = 0;
+};
+
+// Bytes held by one executor: its pool chunks, the frame slots in use and the string, array and range buffers of its
+// vars. Type callbacks get no executor, so buffers are charged through the header of the pool chunk or region block
+// the var lives in (ChargeVarBytes).
+struct MemoryUsage {
+	size_t bytes = 0;
+	size_t peakBytes = 0;
+
+	void Charge(size_t size) {
+		this->bytes += size;
+		this->peakBytes = std::max(this->peakBytes, this->bytes);
 	}
-	inline RuntimeVar* Pop(){
-		if (this->lst.empty())
-			return nullptr;
-		RuntimeVar* var = this->lst.front();
-		this->lst.pop_front();
+	void Credit(size_t size) { this->bytes -= size; }
+};
+
+// first fields of VarPool chunks and VarRegion blocks, which are aligned to varStorageAlign
+struct VarStorageHeader {
+	const void* owner;
+	MemoryUsage* usage;
+};
+constexpr size_t varStorageAlign = 2 * 1024 * 1024;
+
+inline MemoryUsage* UsageOf(RuntimeVar* var) {
+	return reinterpret_cast<VarStorageHeader*>(reinterpret_cast<uintptr_t>(var) & ~(uintptr_t)(varStorageAlign - 1))->usage;
+}
+// a buffer var owns was allocated (positive size) or freed (negative); never called for immortals, they own none
+inline void ChargeVarBytes(RuntimeVar* var, ptrdiff_t size) {
+	MemoryUsage* usage = UsageOf(var);
+	if (size >= 0)
+		usage->Charge(size);
+	else
+		usage->Credit(-size);
+}
+
+// Slab allocator for RuntimeVar: chunks doubling in size up to maxChunkSize, each with its own occupancy count and
+// intrusive free list threaded through data.custom.dataBlob of the free (Null) vars. Chunks are aligned to chunkAlign,
+// so a var finds its chunk by masking its address and Pop and Return stay O(1). Chunks also carry the allocated and
+// mark bitmaps the GarbageCollector sweeps with.
+class VarPool {
+public:
+	static constexpr size_t firstChunkSize = 1024;
+	static constexpr size_t maxChunkSize = 64 * 1024;
+	static constexpr size_t chunkAlign = varStorageAlign;
+
+	explicit VarPool(MemoryUsage* usage_) : usage(usage_), current(nullptr), collecting(false), sweepChunk(0), sweepWord(0) {}
+	VarPool(const VarPool&) = delete;
+	VarPool& operator=(const VarPool&) = delete;
+	~VarPool();
+
+	inline RuntimeVar* Pop(RuntimeCtx* ctx) {
+		if (!this->current || !this->current->freeList)
+			this->Refill(ctx);
+		Chunk* chunk = this->current;
+		RuntimeVar* var = chunk->freeList;
+		chunk->freeList = static_cast<RuntimeVar*>(var->data.custom.dataBlob);
+		chunk->used += 1;
+		size_t idx = var - chunk->Vars();
+		chunk->Allocated()[idx / 64] |= 1ull << (idx % 64);
+		if (this->collecting) // allocated black, the current cycle keeps it
+			chunk->Marks()[idx / 64] |= 1ull << (idx % 64);
 		return var;
 	}
-	inline bool Return(RuntimeCtx* ctx, RuntimeVar* var) {
-		assert(var >= this->block && var <= this->block + this->size);
+	inline void Return(RuntimeCtx* ctx, RuntimeVar* var) {
+		assert(this->Owns(var));
 		if (!var->NativeTypeConvert(ctx->GetType(ERuntimeType::Null)))
 			assert(false); // type can't be constructed to Null??
-		this->lst.push_back(var);
+		Chunk* chunk = ChunkOf(var);
+		var->data.custom.dataBlob = chunk->freeList;
+		chunk->freeList = var;
+		chunk->used -= 1;
+		size_t idx = var - chunk->Vars();
+		chunk->Allocated()[idx / 64] &= ~(1ull << (idx % 64));
+		if (chunk != this->current) {
+			if (chunk->used + 1 == chunk->size)
+				this->available.push_back(chunk);
+			// chunks stay put during a collection, the collector trims when it is done
+			else if (chunk->used == 0 && this->policy.trim == EVarPoolTrim::Eager && !this->collecting)
+				this->Release(chunk);
+		}
+	}
+
+	// hands every empty chunk but the current one back, down to the retained capacity
+	void Trim();
+	void SetPolicy(const VarPoolPolicy& policy_) { this->policy = policy_; }
+	VarPoolStats GetStats() const;
+	bool Owns(RuntimeVar* var) const;
+	const VarPoolPolicy& GetPolicy() const { return this->policy; }
+
+	// Collection support. BeginCollection clears every mark and marks new vars until EndCollection; Mark sets the
+	// bit of a var of this pool and returns whether it was unmarked, vars of other pools and of regions are ignored.
+	void BeginCollection();
+	void EndCollection();
+	inline bool Mark(RuntimeVar* var) {
+		Chunk* chunk = ChunkOf(var);
+		if (chunk->owner != this)
+			return false;
+		size_t idx = var - chunk->Vars();
+		uint64_t& word = chunk->Marks()[idx / 64];
+		uint64_t bit = 1ull << (idx % 64);
+		if (word & bit)
+			return false;
+		word |= bit;
 		return true;
 	}
+	// returns allocated, unmarked vars to the pool, about budget vars per call; true once every chunk is swept
+	bool Sweep(RuntimeCtx* ctx, size_t budget, size_t& freed);
+
+private:
+	// header, allocated bitmap, mark bitmap, vars
+	struct Chunk : VarStorageHeader {
+		size_t size; // multiple of 64
+		size_t used;
+		RuntimeVar* freeList;
+
+		size_t Words() const { return this->size / 64; }
+		uint64_t* Allocated() { return reinterpret_cast<uint64_t*>(this + 1); }
+		uint64_t* Marks() { return this->Allocated() + this->Words(); }
+		RuntimeVar* Vars() { return reinterpret_cast<RuntimeVar*>(this->Marks() + this->Words()); }
+		static size_t Bytes(size_t size) { return sizeof(Chunk) + size / 64 * 2 * sizeof(uint64_t) + size * sizeof(RuntimeVar); }
+	};
+	static_assert(sizeof(Chunk) % alignof(RuntimeVar) == 0);
+	static_assert(firstChunkSize % 64 == 0);
+	static_assert(sizeof(Chunk) + maxChunkSize / 64 * 2 * sizeof(uint64_t) + maxChunkSize * sizeof(RuntimeVar) <= chunkAlign);
+
+	static Chunk* ChunkOf(RuntimeVar* var) {
+		return reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(var) & ~(uintptr_t)(chunkAlign - 1));
+	}
+
+	MemoryUsage* usage; // charged for whole chunks
+	std::vector<Chunk*> chunks;
+	std::vector<Chunk*> available; // chunks with free vars, other than current
+	Chunk* current;
+	VarPoolPolicy policy;
+	VarPoolStats stats;
+	bool collecting;
+	size_t sweepChunk; // Sweep position: index into chunks and bitmap word within it
+	size_t sweepWord;
+
+	void Refill(RuntimeCtx* ctx);
+	// frees an empty chunk unless that would drop the capacity below the retained one
+	bool Release(Chunk* chunk);
+};
+
+// LIFO bump allocator for the frame slots of script calls: a call pushes all of its slots on entry and pops them in
+// one step on return. The block is aligned like VarPool chunks and starts with the same header, so VarPool::Mark can
+// tell region vars apart. Push fails once the block is full and the call keeps its temporaries in the scope instead.
+// Only the slots in use are charged to the executor's MemoryUsage.
+class VarRegion {
+public:
+	explicit VarRegion(MemoryUsage* usage_) : usage(usage_), block(nullptr), top(0) {}
+	VarRegion(const VarRegion&) = delete;
+	VarRegion& operator=(const VarRegion&) = delete;
+	~VarRegion();
+
+	// count Null vars, null when they do not fit
+	RuntimeVar* Push(RuntimeCtx* ctx, size_t count);
+	// drops base and every var above it; only strings, arrays and custom values have anything to destroy
+	void Pop(RuntimeCtx* ctx, RuntimeVar* base);
+	void Clear(RuntimeCtx* ctx) {
+		if (this->block)
+			this->Pop(ctx, this->block->Vars());
+	}
+	std::span<RuntimeVar> GetLive() { return this->block ? std::span<RuntimeVar>(this->block->Vars(), this->top) : std::span<RuntimeVar>(); }
+
+private:
+	struct Block : VarStorageHeader {
+		RuntimeVar* Vars() { return reinterpret_cast<RuntimeVar*>(this + 1); }
+	};
+	static_assert(sizeof(Block) % alignof(RuntimeVar) == 0);
+	static constexpr size_t capacity = (VarPool::chunkAlign - sizeof(Block)) / sizeof(RuntimeVar);
+
+	MemoryUsage* usage;
+	Block* block;
+	size_t top;
 };
 
 struct LocalVarState {
 	RuntimeVar* var;
+	bool borrowed; // var is owned by an array, never returned to the pool through this scope
 	//bool dirty;
 };
 
 struct LocalScope {
 	std::unordered_map<std::string, LocalVarState> locals;
 	std::unordered_map<std::string, LocalVarState> parentLocals;
+	RuntimeVar* slots = nullptr; // frame slots in the executor's VarRegion, null when the method has none or they did not fit
 
 public:
 	LocalScope() = default;
@@ -554,6 +989,17 @@ public:
 
 	LocalVarState GetLocal(RuntimeExecutor* exec, RuntimeCtx* ctx, const std::string name);
 	void SetLocal(RuntimeExecutor* exec, RuntimeCtx* ctx, const std::string& varName, RuntimeVar* next, bool isParent);
+	void BorrowLocal(RuntimeExecutor* exec, RuntimeCtx* ctx, const std::string& varName, RuntimeVar* alias);
+	// the slot of a `#n` name; without slots those names live in locals like any other
+	RuntimeVar* FindSlot(const std::string& name) {
+		if (!this->slots || name.empty() || name[0] != '#')
+			return nullptr;
+		uint32_t idx = 0;
+		for (size_t i = 1; i < name.size(); ++i) {
+			idx = idx * 10 + (name[i] - '0');
+		}
+		return this->slots + idx;
+	}
 
 	/*inline bool PushParentVariable(const std::string& str) {
 		if (!this->parent) return false;
@@ -562,7 +1008,20 @@ public:
 	}*/
 };
 
+// Bounds for executors running untrusted work, like compile-time evaluation. 0 = unlimited.
+struct ExecutorLimits {
+	uint64_t steps = 0; // instructions executed
+	size_t vars = 0; // vars alive at once
+	size_t depth = 0; // nested script calls
+	size_t bytes = 0; // MemoryUsage::bytes, checked at safepoints and before large buffers
+};
+
+class GarbageCollector;
+struct GcPolicy;
+struct GcStats;
+
 class RuntimeExecutor {
+	friend class GarbageCollector;
 private:
 	REG ip;
 	REG lastErrorIp;
@@ -570,21 +1029,56 @@ private:
 
 	bool isErrored;
 	std::string errorMessage;
-	std::map<RuntimeVar*, VarPool<RuntimeVar>> varPool;
+	MemoryUsage memory; // before the pool and region, which keep a pointer to it
+	VarPool varPool;
+	VarRegion region; // frame slots of the active calls
 	LocalScope* currentScope;
+	std::vector<LocalScope*> scopeStack; // scopes of the callers of the current call
+	std::vector<RuntimeVar*> pinned; // GC roots outside any scope
+
+	ExecutorLimits limits;
+	uint64_t steps;
+	size_t liveVars;
+	size_t depth;
+
+	GarbageCollector* collector;
+	size_t gcTrigger; // liveVars at which the next safepoint runs the collector
 
 	LocalVarState GetLocal(RuntimeCtx* ctx, const std::string& name);
 	void SetLocal(RuntimeCtx* ctx, const std::string& varName, RuntimeVar* next);
+	void WriteInt64(RuntimeCtx* ctx, const std::string& varName, int64_t value); // in place, no pool traffic
+	void BorrowLocal(RuntimeCtx* ctx, const std::string& varName, RuntimeVar* alias);
 
 	RuntimeVar* ExecuteInstr(RuntimeCtx* ctx, RuntimeInstr* instr);
 public:
-	~RuntimeExecutor() {
-		if (this->currentScope) {
-			delete this->currentScope;
-			this->currentScope = nullptr;
-		}
+	~RuntimeExecutor();
+	RuntimeExecutor();
+	void SetLimits(const ExecutorLimits& limits_) { this->limits = limits_; }
+	void SetGcPolicy(const GcPolicy& policy);
+	const GcStats& GetGcStats() const;
+	void CollectGarbage(RuntimeCtx* ctx);
+	// destroys every var the executor still holds, pinned ones included; for teardown once nothing runs
+	void ReleaseVars(RuntimeCtx* ctx);
+	// keeps a var that no scope holds, like a folded constant, alive for the executor's lifetime
+	void PinVar(RuntimeVar* var) { this->pinned.push_back(var); }
+	void SetPoolPolicy(const VarPoolPolicy& policy) { this->varPool.SetPolicy(policy); }
+	void TrimPool() { this->varPool.Trim(); }
+	VarPoolStats GetPoolStats() const { return this->varPool.GetStats(); }
+	const MemoryUsage& GetMemoryUsage() const { return this->memory; }
+	// instructions executed, counted while a step limit is set
+	uint64_t GetSteps() const { return this->steps; }
+	// false, with the executor errored, when size more bytes would go over the memory limit
+	bool ReserveBytes(size_t size);
+	// drops the scope the outermost call leaves behind
+	void ReleaseScope(RuntimeCtx* ctx) {
+		if (!this->currentScope)
+			return;
+		this->currentScope->Destroy(this, ctx);
+		if (this->currentScope->slots)
+			this->region.Pop(ctx, this->currentScope->slots);
+		delete this->currentScope;
+		this->currentScope = nullptr;
 	}
-	RuntimeExecutor() : ip(INVALID_REG_VALUE), lastErrorIp(INVALID_REG_VALUE), isErrored(false), currentScope(nullptr) {};
 	void Reset() {
 		this->isErrored = false;
 		while (!this->stack.empty()) this->stack.pop();
@@ -595,9 +1089,179 @@ public:
 	bool IsErrored() { return this->isErrored; }
 	std::string GetError() { return this->errorMessage; }
 
-	RuntimeVar* CallMethod(RuntimeCtx* ctx, RuntimeMethod* method, const RuntimeParamPack& params);
+	RuntimeVar* CallMethod(RuntimeCtx* ctx, RuntimeMethod* method, RuntimeArgs params);
 	RuntimeVar* CreateVar(RuntimeCtx* ctx);
 	RuntimeVar* CreateTypedVar(RuntimeCtx* ctx, RuntimeType* type);
+	// an Int64 result: the shared immortal for small values, which must not be written through, else a pooled var
+	RuntimeVar* CreateInt64(RuntimeCtx* ctx, int64_t value);
 	void ReturnVar(RuntimeCtx* ctx, RuntimeVar* var);
 };
 
+
+// Array argument of a typed native, the var stays owned by the caller.
+struct RuntimeArrayView {
+	RuntimeVar* var = nullptr;
+
+	uint32_t size() const { return this->var->data.arr.size; }
+	RuntimeVar* operator[](size_t idx) const { return this->var->data.arr.data[idx]; }
+	RuntimeVar** begin() const { return this->var->data.arr.data; }
+	RuntimeVar** end() const { return this->var->data.arr.data + this->var->data.arr.size; }
+};
+
+// Dict or SortedMap argument of the map natives, the var stays owned by the caller.
+struct RuntimeMapView {
+	RuntimeVar* var = nullptr;
+
+	bool IsSorted() const { return this->var->GetType()->GetTypeEnum() == ERuntimeType::SortedMap; }
+	RuntimeDict* Dict() const { return static_cast<RuntimeDict*>(this->var->data.custom.dataBlob); }
+	RuntimeSortedMap* Sorted() const { return static_cast<RuntimeSortedMap*>(this->var->data.custom.dataBlob); }
+};
+
+// Container argument of a typed native, T is the data blob its type holds; the var stays owned by the caller.
+template<typename T, ERuntimeType typeEnum>
+struct RuntimeBlobView {
+	static constexpr ERuntimeType type = typeEnum;
+	RuntimeVar* var = nullptr;
+
+	T* operator->() const { return static_cast<T*>(this->var->data.custom.dataBlob); }
+	T& operator*() const { return *this->operator->(); }
+};
+using RuntimeSortedMapView = RuntimeBlobView<RuntimeSortedMap, ERuntimeType::SortedMap>;
+using RuntimeBitsetView = RuntimeBlobView<RuntimeBitset, ERuntimeType::Bitset>;
+using RuntimeHeapView = RuntimeBlobView<RuntimeHeap, ERuntimeType::Heap>;
+using RuntimeDequeView = RuntimeBlobView<RuntimeDeque, ERuntimeType::Deque>;
+
+// Conversion of one script value to a typed native parameter, false when the type does not match.
+template<typename T>
+struct NativeArg;
+
+template<>
+struct NativeArg<RuntimeVar*> {
+	static constexpr const char* typeName = "any";
+	static bool Get(RuntimeVar* var, RuntimeVar*& out) { out = var; return true; }
+};
+template<>
+struct NativeArg<int64_t> {
+	static constexpr const char* typeName = "Int64";
+	static bool Get(RuntimeVar* var, int64_t& out) {
+		if (var->GetType()->GetTypeEnum() != ERuntimeType::Int64)
+			return false;
+		out = var->data.i64;
+		return true;
+	}
+};
+template<>
+struct NativeArg<double> {
+	static constexpr const char* typeName = "Double";
+	static bool Get(RuntimeVar* var, double& out) {
+		if (var->GetType()->GetTypeEnum() == ERuntimeType::Int64)
+			out = (double)var->data.i64;
+		else if (var->GetType()->GetTypeEnum() == ERuntimeType::Double)
+			out = var->data.dbl;
+		else
+			return false;
+		return true;
+	}
+};
+template<>
+struct NativeArg<std::string_view> {
+	static constexpr const char* typeName = "String";
+	static bool Get(RuntimeVar* var, std::string_view& out) {
+		if (var->GetType()->GetTypeEnum() != ERuntimeType::String)
+			return false;
+		out = std::string_view(var->data.str.ptr, var->data.str.size);
+		return true;
+	}
+};
+template<>
+struct NativeArg<RuntimeMapView> {
+	static constexpr const char* typeName = "Dict or SortedMap";
+	static bool Get(RuntimeVar* var, RuntimeMapView& out) {
+		ERuntimeType type = var->GetType()->GetTypeEnum();
+		if (type != ERuntimeType::Dict && type != ERuntimeType::SortedMap)
+			return false;
+		out.var = var;
+		return true;
+	}
+};
+template<typename T, ERuntimeType typeEnum>
+struct NativeArg<RuntimeBlobView<T, typeEnum>> {
+	static constexpr const char* typeName = ERuntimeType_ToString(typeEnum);
+	static bool Get(RuntimeVar* var, RuntimeBlobView<T, typeEnum>& out) {
+		if (var->GetType()->GetTypeEnum() != typeEnum)
+			return false;
+		out.var = var;
+		return true;
+	}
+};
+template<>
+struct NativeArg<RuntimeArrayView> {
+	static constexpr const char* typeName = "Array";
+	static bool Get(RuntimeVar* var, RuntimeArrayView& out) {
+		if (var->GetType()->GetTypeEnum() != ERuntimeType::Array)
+			return false;
+		out.var = var;
+		return true;
+	}
+};
+
+inline RuntimeVar* NativeResult(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeVar* value) {
+	return value;
+}
+inline RuntimeVar* NativeResult(RuntimeCtx* ctx, RuntimeExecutor* exec, int64_t value) {
+	return exec->CreateInt64(ctx, value);
+}
+inline RuntimeVar* NativeResult(RuntimeCtx* ctx, RuntimeExecutor* exec, double value) {
+	RuntimeVar* var = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::Double));
+	var->data.dbl = value;
+	return var;
+}
+inline RuntimeVar* NativeResult(RuntimeCtx* ctx, RuntimeExecutor* exec, const std::string& value) {
+	RuntimeVar* var = exec->CreateTypedVar(ctx, ctx->GetType(ERuntimeType::String));
+	var->ConstructString(value.data(), value.size());
+	return var;
+}
+
+template<auto Fn>
+struct NativeThunk;
+
+// Adapts `R fn(RuntimeCtx*, RuntimeExecutor*, Args...)` to RuntimeMethodPtr: checks and converts every argument,
+// then wraps the result. void natives return Null.
+template<typename R, typename... Args, R(*Fn)(RuntimeCtx*, RuntimeExecutor*, Args...)>
+struct NativeThunk<Fn> {
+	static constexpr size_t arity = sizeof...(Args);
+
+	static RuntimeVar* Call(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeArgs params) {
+		return Invoke(ctx, exec, params, std::index_sequence_for<Args...>{});
+	}
+
+private:
+	template<size_t... I>
+	static RuntimeVar* Invoke(RuntimeCtx* ctx, RuntimeExecutor* exec, RuntimeArgs params, std::index_sequence<I...>) {
+		std::tuple<Args...> args;
+		size_t failed = arity;
+		((failed == arity && !NativeArg<Args>::Get(params[I], std::get<I>(args)) ? failed = I : 0), ...);
+		if (failed < arity) {
+			const char* expected[] = { NativeArg<Args>::typeName..., "" };
+			exec->SetError("Invalid argument " + std::to_string(failed + 1) + ", expected " + expected[failed] + ", got " + params[failed]->GetType()->GetName());
+			return nullptr;
+		}
+		if constexpr (std::is_void_v<R>) {
+			Fn(ctx, exec, std::get<I>(args)...);
+			return exec->CreateVar(ctx);
+		}
+		else {
+			return NativeResult(ctx, exec, Fn(ctx, exec, std::get<I>(args)...));
+		}
+	}
+};
+
+// One-line registration of a typed native: ctx->AddMethod(MakeNative<&Native_Int>("int"));
+template<auto Fn>
+RuntimeMethod* MakeNative(const std::string& name) {
+	std::vector<std::string> params;
+	for (size_t i = 0; i < NativeThunk<Fn>::arity; ++i) {
+		params.push_back("arg" + std::to_string(i));
+	}
+	return new RuntimeMethod(name, params, &NativeThunk<Fn>::Call);
+}
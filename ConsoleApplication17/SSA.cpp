@@ -0,0 +1,132 @@
+#include "SSA.h"
+
+SSAForm::SSAForm(const ControlFlowGraph& cfg) {
+	const size_t count = cfg.GetBlockCount();
+	this->phis.resize(count);
+	this->uses.resize(count);
+	this->defs.resize(count);
+
+	std::vector<std::vector<int>> children(count);
+	std::vector<std::set<int>> frontier(count);
+	for (int id : cfg.GetLayout()) {
+		if (!cfg.IsReachable(id))
+			continue;
+		int idom = cfg.GetImmediateDominator(id);
+		if (idom >= 0)
+			children[idom].push_back(id);
+		const BasicBlock& block = cfg.GetBlock(id);
+		if (block.preds.size() < 2 && id != cfg.GetEntry())
+			continue;
+		for (int pred : block.preds) {
+			for (int runner = pred; runner >= 0 && runner != idom && cfg.IsReachable(runner); runner = cfg.GetImmediateDominator(runner)) {
+				frontier[runner].insert(id);
+			}
+		}
+	}
+
+	std::map<std::string, std::set<int>> defBlocks;
+	for (int id : cfg.GetLayout()) {
+		if (!cfg.IsReachable(id))
+			continue;
+		for (auto& instr : cfg.GetBlock(id).instrs) {
+			for (auto& def : instr.GetDefinedVars()) {
+				defBlocks[def].insert(id);
+			}
+		}
+	}
+	for (auto& [var, blocks] : defBlocks) {
+		std::vector<int> work(blocks.begin(), blocks.end());
+		while (!work.empty()) {
+			int id = work.back();
+			work.pop_back();
+			for (int f : frontier[id]) {
+				if (this->phis[f].count(var))
+					continue;
+				int phi = this->AddValue(SSAValue::EKind::Phi, var, f, -1);
+				size_t argCount = cfg.GetBlock(f).preds.size() + (f == cfg.GetEntry() ? 1 : 0);
+				this->values[phi].args.assign(argCount, -1);
+				this->phis[f][var] = phi;
+				if (!blocks.count(f))
+					work.push_back(f);
+			}
+		}
+	}
+
+	for (auto& [var, phi] : this->phis[cfg.GetEntry()]) {
+		this->values[phi].args.back() = this->GetCurrent(var);
+	}
+	this->Rename(cfg, cfg.GetEntry(), children);
+	this->stacks.clear();
+
+	this->useCount.assign(this->values.size(), 0);
+	for (size_t id = 0; id < count; ++id) {
+		for (auto& [var, phi] : this->phis[id]) {
+			for (int arg : this->values[phi].args) {
+				if (arg >= 0)
+					this->useCount[arg] += 1;
+			}
+		}
+		for (auto& instrUses : this->uses[id]) {
+			for (int value : instrUses) {
+				this->useCount[value] += 1;
+			}
+		}
+	}
+}
+
+int SSAForm::AddValue(SSAValue::EKind kind, const std::string& var, int block, int instr) {
+	SSAValue value;
+	value.kind = kind;
+	value.var = var;
+	value.block = block;
+	value.instr = instr;
+	this->values.push_back(value);
+	return this->values.size() - 1;
+}
+
+int SSAForm::GetCurrent(const std::string& var) {
+	auto& stack = this->stacks[var];
+	if (stack.empty())
+		stack.push_back(this->AddValue(SSAValue::EKind::Entry, var, -1, -1)); // stays at the bottom for the whole walk
+	return stack.back();
+}
+
+void SSAForm::Rename(const ControlFlowGraph& cfg, int id, const std::vector<std::vector<int>>& children) {
+	std::vector<std::string> pushed;
+	for (auto& [var, phi] : this->phis[id]) {
+		this->GetCurrent(var);
+		this->stacks[var].push_back(phi);
+		pushed.push_back(var);
+	}
+
+	const BasicBlock& block = cfg.GetBlock(id);
+	this->uses[id].resize(block.instrs.size());
+	this->defs[id].resize(block.instrs.size());
+	for (size_t i = 0; i < block.instrs.size(); ++i) {
+		for (auto& used : block.instrs[i].GetUsedVars()) {
+			this->uses[id][i].push_back(this->GetCurrent(used));
+		}
+		for (auto& def : block.instrs[i].GetDefinedVars()) {
+			this->GetCurrent(def);
+			int value = this->AddValue(SSAValue::EKind::Instr, def, id, i);
+			this->stacks[def].push_back(value);
+			this->defs[id][i].push_back(value);
+			pushed.push_back(def);
+		}
+	}
+
+	for (int succ : block.GetSuccessors()) {
+		const auto& preds = cfg.GetBlock(succ).preds;
+		size_t predIdx = std::find(preds.begin(), preds.end(), id) - preds.begin();
+		for (auto& [var, phi] : this->phis[succ]) {
+			this->values[phi].args[predIdx] = this->GetCurrent(var);
+		}
+	}
+
+	for (int child : children[id]) {
+		this->Rename(cfg, child, children);
+	}
+	for (auto it = pushed.rbegin(); it != pushed.rend(); ++it) {
+		this->stacks[*it].pop_back();
+	}
+}
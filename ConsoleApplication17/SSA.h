@@ -0,0 +1,49 @@
+#pragma once
+#include "ControlFlow.h"
+
+// One definition of a local. Entry values stand for whatever a local holds when the method starts (a param, or Null),
+// phis merge the values reaching a block.
+struct SSAValue {
+	enum class EKind {
+		Entry,
+		Phi,
+		Instr,
+	};
+
+	EKind kind;
+	std::string var;
+	int block; // -1 for entry values
+	int instr; // index in the block for Instr values
+	std::vector<int> args; // phi: one value per BasicBlock::preds entry, -1 from unreachable blocks; the entry block has one more for the method start
+};
+
+// SSA numbering over a ControlFlowGraph. The executable form keeps local names: versions of a local never overlap as
+// long as passes don't move definitions of a named local past each other, so leaving SSA renames nothing.
+// Rebuild after changing the graph.
+class SSAForm {
+public:
+	explicit SSAForm(const ControlFlowGraph& cfg);
+
+	const SSAValue& GetValue(int id) const { return this->values[id]; }
+	size_t GetValueCount() const { return this->values.size(); }
+	const std::map<std::string, int>& GetPhis(int block) const { return this->phis[block]; }
+
+	// values read and written by an instruction, in GetUsedVars/GetDefinedVars order; empty in unreachable blocks
+	const std::vector<int>& GetUses(int block, size_t instr) const { return this->uses[block][instr]; }
+	const std::vector<int>& GetDefs(int block, size_t instr) const { return this->defs[block][instr]; }
+	// reads by instructions and phis
+	size_t GetUseCount(int value) const { return this->useCount[value]; }
+
+private:
+	int AddValue(SSAValue::EKind kind, const std::string& var, int block, int instr);
+	int GetCurrent(const std::string& var);
+	void Rename(const ControlFlowGraph& cfg, int id, const std::vector<std::vector<int>>& children);
+
+	std::vector<SSAValue> values;
+	std::vector<std::map<std::string, int>> phis;
+	std::vector<std::vector<std::vector<int>>> uses;
+	std::vector<std::vector<std::vector<int>>> defs;
+	std::vector<size_t> useCount;
+
+	std::map<std::string, std::vector<int>> stacks; // renaming state
+};
@@ -0,0 +1,356 @@
+#include "SortedMap.h"
+#include "Precompile.h"
+#include <algorithm>
+
+bool RuntimeKeyOrder::Less(RuntimeVar* a, RuntimeVar* b) const {
+	return Precompile::Less(this->ctx, this->exec, a, b);
+}
+
+bool RuntimeKeyOrder::Failed() const {
+	return this->exec->IsErrored();
+}
+
+RuntimeSortedMap::~RuntimeSortedMap() {
+	if (this->root)
+		this->FreeTree(this->root);
+}
+
+size_t RuntimeSortedMap::Search(const Node* node, RuntimeVar* key, const RuntimeKeyOrder& order, bool lower) {
+	size_t lo = 0;
+	size_t hi = node->count;
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		bool before = lower ? order.Less(node->keys[mid], key) : !order.Less(key, node->keys[mid]);
+		if (before)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+size_t RuntimeSortedMap::SubtreeSize(const Node* node) {
+	size_t total = node->count;
+	if (!node->leaf) {
+		const Inner* inner = static_cast<const Inner*>(node);
+		for (uint32_t i = 0; i <= inner->count; ++i) {
+			total += inner->sizes[i];
+		}
+	}
+	return total;
+}
+
+RuntimeVar** RuntimeSortedMap::Find(RuntimeVar* key, const RuntimeKeyOrder& order) const {
+	Node* node = this->root;
+	while (node) {
+		size_t idx = Search(node, key, order, true);
+		bool found = idx < node->count && !order.Less(key, node->keys[idx]);
+		if (order.Failed())
+			return nullptr;
+		if (found)
+			return &node->values[idx];
+		if (node->leaf)
+			return nullptr;
+		node = static_cast<Inner*>(node)->children[idx];
+	}
+	return nullptr;
+}
+
+void RuntimeSortedMap::Append(RuntimeVar* key, RuntimeVar* value) {
+	if (!this->root)
+		this->root = this->NewLeaf();
+	Step path[maxDepth];
+	size_t depth = 0;
+	Node* node = this->root;
+	while (!node->leaf) {
+		Inner* inner = static_cast<Inner*>(node);
+		path[depth++] = { inner, inner->count };
+		node = inner->children[inner->count];
+	}
+	this->InsertAt(node, node->count, key, value, path, depth);
+}
+
+void RuntimeSortedMap::InsertAt(Node* leaf, size_t pos, RuntimeVar* key, RuntimeVar* value, Step* path, size_t depth) {
+	std::copy_backward(leaf->keys + pos, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+	std::copy_backward(leaf->values + pos, leaf->values + leaf->count, leaf->values + leaf->count + 1);
+	leaf->keys[pos] = key;
+	leaf->values[pos] = value;
+	leaf->count += 1;
+	for (size_t i = 0; i < depth; ++i) {
+		path[i].node->sizes[path[i].child] += 1;
+	}
+	this->size += 1;
+
+	// an overflowing node splits and pushes its median up, which may overflow the parent in turn
+	Node* node = leaf;
+	while (node->count > maxKeys) {
+		Entry median;
+		Node* right = this->Split(node, median);
+		if (depth == 0) {
+			Inner* top = this->NewInner();
+			top->count = 1;
+			top->keys[0] = median.key;
+			top->values[0] = median.value;
+			top->children[0] = node;
+			top->children[1] = right;
+			top->sizes[0] = SubtreeSize(node);
+			top->sizes[1] = SubtreeSize(right);
+			this->root = top;
+			break;
+		}
+		const Step& step = path[--depth];
+		Inner* parent = step.node;
+		size_t idx = step.child;
+		std::copy_backward(parent->keys + idx, parent->keys + parent->count, parent->keys + parent->count + 1);
+		std::copy_backward(parent->values + idx, parent->values + parent->count, parent->values + parent->count + 1);
+		std::copy_backward(parent->children + idx + 1, parent->children + parent->count + 1, parent->children + parent->count + 2);
+		std::copy_backward(parent->sizes + idx + 1, parent->sizes + parent->count + 1, parent->sizes + parent->count + 2);
+		parent->keys[idx] = median.key;
+		parent->values[idx] = median.value;
+		parent->children[idx + 1] = right;
+		parent->sizes[idx] = SubtreeSize(node);
+		parent->sizes[idx + 1] = SubtreeSize(right);
+		parent->count += 1;
+		node = parent;
+	}
+}
+
+RuntimeSortedMap::Node* RuntimeSortedMap::Split(Node* node, Entry& median) {
+	size_t mid = node->count / 2;
+	size_t rightCount = node->count - mid - 1;
+	Node* right = node->leaf ? this->NewLeaf() : this->NewInner();
+	std::copy_n(node->keys + mid + 1, rightCount, right->keys);
+	std::copy_n(node->values + mid + 1, rightCount, right->values);
+	if (!node->leaf) {
+		Inner* inner = static_cast<Inner*>(node);
+		Inner* rightInner = static_cast<Inner*>(right);
+		std::copy_n(inner->children + mid + 1, rightCount + 1, rightInner->children);
+		std::copy_n(inner->sizes + mid + 1, rightCount + 1, rightInner->sizes);
+	}
+	median = { node->keys[mid], node->values[mid] };
+	right->count = (uint32_t)rightCount;
+	node->count = (uint32_t)mid;
+	return right;
+}
+
+bool RuntimeSortedMap::Remove(RuntimeVar* key, const RuntimeKeyOrder& order, Entry& removed) {
+	if (!this->root)
+		return false;
+	Step path[maxDepth];
+	size_t depth = 0;
+	Node* node = this->root;
+	size_t idx;
+	for (;;) {
+		idx = Search(node, key, order, true);
+		bool found = idx < node->count && !order.Less(key, node->keys[idx]);
+		if (order.Failed())
+			return false;
+		if (found)
+			break;
+		if (node->leaf)
+			return false;
+		Inner* inner = static_cast<Inner*>(node);
+		path[depth++] = { inner, idx };
+		node = inner->children[idx];
+	}
+	removed = { node->keys[idx], node->values[idx] };
+
+	if (!node->leaf) {
+		// the predecessor, last entry of the left subtree, takes the place of the removed one
+		Inner* inner = static_cast<Inner*>(node);
+		path[depth++] = { inner, idx };
+		Node* leaf = inner->children[idx];
+		while (!leaf->leaf) {
+			Inner* next = static_cast<Inner*>(leaf);
+			path[depth++] = { next, next->count };
+			leaf = next->children[next->count];
+		}
+		node->keys[idx] = leaf->keys[leaf->count - 1];
+		node->values[idx] = leaf->values[leaf->count - 1];
+		node = leaf;
+		idx = leaf->count - 1;
+	}
+	std::copy(node->keys + idx + 1, node->keys + node->count, node->keys + idx);
+	std::copy(node->values + idx + 1, node->values + node->count, node->values + idx);
+	node->count -= 1;
+	for (size_t i = 0; i < depth; ++i) {
+		path[i].node->sizes[path[i].child] -= 1;
+	}
+	this->size -= 1;
+
+	// an underflowing node borrows from a sibling that can spare a key, or merges with one, which may underflow the parent
+	while (depth > 0 && node->count < minKeys) {
+		const Step& step = path[--depth];
+		Inner* parent = step.node;
+		size_t child = step.child;
+		if (child > 0 && parent->children[child - 1]->count > minKeys)
+			this->RotateRight(parent, child - 1);
+		else if (child < parent->count && parent->children[child + 1]->count > minKeys)
+			this->RotateLeft(parent, child);
+		else
+			this->Merge(parent, child > 0 ? child - 1 : child);
+		node = parent;
+	}
+	if (this->root->count == 0) {
+		Node* old = this->root;
+		this->root = old->leaf ? nullptr : static_cast<Inner*>(old)->children[0];
+		this->FreeNode(old);
+	}
+	return true;
+}
+
+void RuntimeSortedMap::RotateRight(Inner* parent, size_t idx) {
+	Node* left = parent->children[idx];
+	Node* right = parent->children[idx + 1];
+	std::copy_backward(right->keys, right->keys + right->count, right->keys + right->count + 1);
+	std::copy_backward(right->values, right->values + right->count, right->values + right->count + 1);
+	right->keys[0] = parent->keys[idx];
+	right->values[0] = parent->values[idx];
+	parent->keys[idx] = left->keys[left->count - 1];
+	parent->values[idx] = left->values[left->count - 1];
+	size_t moved = 1;
+	if (!left->leaf) {
+		Inner* leftInner = static_cast<Inner*>(left);
+		Inner* rightInner = static_cast<Inner*>(right);
+		std::copy_backward(rightInner->children, rightInner->children + right->count + 1, rightInner->children + right->count + 2);
+		std::copy_backward(rightInner->sizes, rightInner->sizes + right->count + 1, rightInner->sizes + right->count + 2);
+		rightInner->children[0] = leftInner->children[left->count];
+		rightInner->sizes[0] = leftInner->sizes[left->count];
+		moved += rightInner->sizes[0];
+	}
+	left->count -= 1;
+	right->count += 1;
+	parent->sizes[idx] -= moved;
+	parent->sizes[idx + 1] += moved;
+}
+
+void RuntimeSortedMap::RotateLeft(Inner* parent, size_t idx) {
+	Node* left = parent->children[idx];
+	Node* right = parent->children[idx + 1];
+	left->keys[left->count] = parent->keys[idx];
+	left->values[left->count] = parent->values[idx];
+	parent->keys[idx] = right->keys[0];
+	parent->values[idx] = right->values[0];
+	std::copy(right->keys + 1, right->keys + right->count, right->keys);
+	std::copy(right->values + 1, right->values + right->count, right->values);
+	size_t moved = 1;
+	if (!left->leaf) {
+		Inner* leftInner = static_cast<Inner*>(left);
+		Inner* rightInner = static_cast<Inner*>(right);
+		leftInner->children[left->count + 1] = rightInner->children[0];
+		leftInner->sizes[left->count + 1] = rightInner->sizes[0];
+		moved += rightInner->sizes[0];
+		std::copy(rightInner->children + 1, rightInner->children + right->count + 1, rightInner->children);
+		std::copy(rightInner->sizes + 1, rightInner->sizes + right->count + 1, rightInner->sizes);
+	}
+	left->count += 1;
+	right->count -= 1;
+	parent->sizes[idx] += moved;
+	parent->sizes[idx + 1] -= moved;
+}
+
+void RuntimeSortedMap::Merge(Inner* parent, size_t idx) {
+	Node* left = parent->children[idx];
+	Node* right = parent->children[idx + 1];
+	left->keys[left->count] = parent->keys[idx];
+	left->values[left->count] = parent->values[idx];
+	std::copy_n(right->keys, right->count, left->keys + left->count + 1);
+	std::copy_n(right->values, right->count, left->values + left->count + 1);
+	if (!left->leaf) {
+		Inner* leftInner = static_cast<Inner*>(left);
+		Inner* rightInner = static_cast<Inner*>(right);
+		std::copy_n(rightInner->children, right->count + 1, leftInner->children + left->count + 1);
+		std::copy_n(rightInner->sizes, right->count + 1, leftInner->sizes + left->count + 1);
+	}
+	left->count += 1 + right->count;
+	parent->sizes[idx] += 1 + parent->sizes[idx + 1];
+
+	std::copy(parent->keys + idx + 1, parent->keys + parent->count, parent->keys + idx);
+	std::copy(parent->values + idx + 1, parent->values + parent->count, parent->values + idx);
+	std::copy(parent->children + idx + 2, parent->children + parent->count + 1, parent->children + idx + 1);
+	std::copy(parent->sizes + idx + 2, parent->sizes + parent->count + 1, parent->sizes + idx + 1);
+	parent->count -= 1;
+	this->FreeNode(right);
+}
+
+size_t RuntimeSortedMap::Bound(RuntimeVar* key, const RuntimeKeyOrder& order, bool lower) const {
+	size_t rank = 0;
+	Node* node = this->root;
+	while (node) {
+		size_t idx = Search(node, key, order, lower);
+		if (order.Failed())
+			return 0;
+		rank += idx;
+		if (node->leaf)
+			break;
+		Inner* inner = static_cast<Inner*>(node);
+		for (size_t i = 0; i < idx; ++i) {
+			rank += inner->sizes[i];
+		}
+		node = inner->children[idx];
+	}
+	return rank;
+}
+
+size_t RuntimeSortedMap::LowerBound(RuntimeVar* key, const RuntimeKeyOrder& order) const {
+	return this->Bound(key, order, true);
+}
+
+size_t RuntimeSortedMap::UpperBound(RuntimeVar* key, const RuntimeKeyOrder& order) const {
+	return this->Bound(key, order, false);
+}
+
+RuntimeSortedMap::Entry RuntimeSortedMap::At(size_t idx) const {
+	Node* node = this->root;
+	while (!node->leaf) {
+		Inner* inner = static_cast<Inner*>(node);
+		for (size_t i = 0;; ++i) {
+			if (idx < inner->sizes[i]) {
+				node = inner->children[i];
+				break;
+			}
+			idx -= inner->sizes[i];
+			if (idx == 0)
+				return { inner->keys[i], inner->values[i] };
+			idx -= 1;
+		}
+	}
+	return { node->keys[idx], node->values[idx] };
+}
+
+RuntimeSortedMap::Node* RuntimeSortedMap::NewLeaf() {
+	Node* node = new Node();
+	node->leaf = true;
+	node->count = 0;
+	this->leaves += 1;
+	return node;
+}
+
+RuntimeSortedMap::Inner* RuntimeSortedMap::NewInner() {
+	Inner* node = new Inner();
+	node->leaf = false;
+	node->count = 0;
+	this->inners += 1;
+	return node;
+}
+
+void RuntimeSortedMap::FreeNode(Node* node) {
+	if (node->leaf) {
+		delete node;
+		this->leaves -= 1;
+	}
+	else {
+		delete static_cast<Inner*>(node);
+		this->inners -= 1;
+	}
+}
+
+void RuntimeSortedMap::FreeTree(Node* node) {
+	if (!node->leaf) {
+		Inner* inner = static_cast<Inner*>(node);
+		for (uint32_t i = 0; i <= inner->count; ++i) {
+			this->FreeTree(inner->children[i]);
+		}
+	}
+	this->FreeNode(node);
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include "Runtime.h"
+
+// Key order of a sorted map: a < b through Precompile::Less, the semantics of the script's `<`.
+struct RuntimeKeyOrder {
+	RuntimeCtx* ctx;
+	RuntimeExecutor* exec;
+
+	bool Less(RuntimeVar* a, RuntimeVar* b) const;
+	// a comparison errored the executor
+	bool Failed() const;
+};
+
+// B-tree held by SortedMap vars, keys ascending. Nodes are wide (up to 31 keys, 32 children), so a lookup
+// binary-searches a few contiguous key arrays instead of chasing a pointer per comparison, and a million keys sit
+// four levels deep. Inner nodes keep the entry count under each child next to the child pointer, which makes rank
+// queries and positional access O(log n) without touching the children.
+// Every update compares first and only then changes the tree, so a comparison that fails leaves the map as it was.
+// Keys and values are vars owned by the map.
+class RuntimeSortedMap {
+public:
+	struct Entry {
+		RuntimeVar* key;
+		RuntimeVar* value;
+	};
+
+	RuntimeSortedMap() : root(nullptr), size(0), leaves(0), inners(0) {}
+	RuntimeSortedMap(const RuntimeSortedMap&) = delete;
+	RuntimeSortedMap& operator=(const RuntimeSortedMap&) = delete;
+	~RuntimeSortedMap();
+
+	// value slot of key, nullptr when it is absent
+	RuntimeVar** Find(RuntimeVar* key, const RuntimeKeyOrder& order) const;
+	// insert-or-assign in one descent: slot points at the value of key when it is present, otherwise the entry
+	// make() returns, the map's own copies of key and its value, is added and slot is nullptr. false when a
+	// comparison failed, in which case make() is not called and the map is unchanged
+	template<typename F>
+	bool Assign(RuntimeVar* key, const RuntimeKeyOrder& order, RuntimeVar**& slot, F make) {
+		slot = nullptr;
+		Step path[maxDepth];
+		size_t depth = 0;
+		Node* node = this->root;
+		size_t idx = 0;
+		while (node) {
+			idx = Search(node, key, order, true);
+			bool found = idx < node->count && !order.Less(key, node->keys[idx]);
+			if (order.Failed())
+				return false;
+			if (found) {
+				slot = &node->values[idx];
+				return true;
+			}
+			if (node->leaf)
+				break;
+			Inner* inner = static_cast<Inner*>(node);
+			path[depth++] = { inner, idx };
+			node = inner->children[idx];
+		}
+		if (!node)
+			node = this->root = this->NewLeaf();
+		Entry entry = make();
+		this->InsertAt(node, idx, entry.key, entry.value, path, depth);
+		return true;
+	}
+	// adds a key greater than every key in the map, for copies
+	void Append(RuntimeVar* key, RuntimeVar* value);
+	// drops key and hands its entry back, false when it is absent
+	bool Remove(RuntimeVar* key, const RuntimeKeyOrder& order, Entry& removed);
+
+	// rank of the first key not less than key, Size() when there is none
+	size_t LowerBound(RuntimeVar* key, const RuntimeKeyOrder& order) const;
+	// rank of the first key greater than key, Size() when there is none
+	size_t UpperBound(RuntimeVar* key, const RuntimeKeyOrder& order) const;
+	// entry of rank idx
+	Entry At(size_t idx) const;
+
+	size_t Size() const { return this->size; }
+	// f(key, value) in key order
+	template<typename F>
+	void ForEach(F f) const {
+		if (this->root)
+			Walk(this->root, f);
+	}
+	// heap bytes, the map itself included, for MemoryUsage
+	size_t GetBytes() const { return sizeof(RuntimeSortedMap) + this->leaves * sizeof(Node) + this->inners * sizeof(Inner); }
+
+private:
+	static constexpr size_t maxKeys = 31;
+	static constexpr size_t minKeys = maxKeys / 2; // for every node but the root
+	static constexpr size_t maxDepth = 16; // nodes below the root have at least minKeys + 1 children
+
+	struct Node {
+		bool leaf;
+		uint32_t count;
+		// one spare slot: a node overflows by one key before it splits
+		RuntimeVar* keys[maxKeys + 1];
+		RuntimeVar* values[maxKeys + 1];
+	};
+	struct Inner : Node {
+		Node* children[maxKeys + 2];
+		size_t sizes[maxKeys + 2]; // entries under each child
+	};
+	// inner node passed on the way down and the child taken
+	struct Step {
+		Inner* node;
+		size_t child;
+	};
+
+	Node* root;
+	size_t size;
+	size_t leaves;
+	size_t inners;
+
+	template<typename F>
+	static void Walk(const Node* node, F& f) {
+		const Inner* inner = node->leaf ? nullptr : static_cast<const Inner*>(node);
+		for (uint32_t i = 0; i < node->count; ++i) {
+			if (inner)
+				Walk(inner->children[i], f);
+			f(node->keys[i], node->values[i]);
+		}
+		if (inner)
+			Walk(inner->children[node->count], f);
+	}
+
+	// first idx whose key is not less than key (lower) or greater than key (!lower)
+	static size_t Search(const Node* node, RuntimeVar* key, const RuntimeKeyOrder& order, bool lower);
+	static size_t SubtreeSize(const Node* node);
+	size_t Bound(RuntimeVar* key, const RuntimeKeyOrder& order, bool lower) const;
+
+	Node* NewLeaf();
+	Inner* NewInner();
+	void FreeNode(Node* node);
+	void FreeTree(Node* node);
+
+	// puts an entry at pos of the leaf reached through path, then splits what overflowed
+	void InsertAt(Node* leaf, size_t pos, RuntimeVar* key, RuntimeVar* value, Step* path, size_t depth);
+	// moves the upper half of node into a new sibling, median returns the key between them
+	Node* Split(Node* node, Entry& median);
+	// children[idx] borrows through the parent from its left or right sibling, or merges with children[idx + 1]
+	void RotateRight(Inner* parent, size_t idx);
+	void RotateLeft(Inner* parent, size_t idx);
+	void Merge(Inner* parent, size_t idx);
+};
@@ -0,0 +1,24 @@
+# Runs one script through the interpreter and compares what it prints with the expected output.
+# Usage: cmake -DBINARY=<interpreter> -DSCRIPT=<name.txt> -DEXPECTED=<name.out> -DFLAGS=<option> -DWORK_DIR=<dir> -P RunScript.cmake
+# The interpreter reads ../input.txt, so the script goes into WORK_DIR and the interpreter runs in WORK_DIR/run.
+file(MAKE_DIRECTORY ${WORK_DIR}/run)
+configure_file(${SCRIPT} ${WORK_DIR}/input.txt COPYONLY)
+execute_process(COMMAND ${BINARY} ${FLAGS}
+    WORKING_DIRECTORY ${WORK_DIR}/run
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE output
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${BINARY} ${FLAGS} exited with ${result}:\n${output}")
+endif()
+
+# compiler dumps and diagnostics aside, only what the script prints and how main ends are compared
+string(REGEX MATCHALL "(^|\n)(\\[Script\\]|Main returned)[^\n]*" lines "${output}")
+string(REPLACE ";\n" "\n" actual "${lines}")
+string(REGEX REPLACE "^\n" "" actual "${actual}")
+file(READ ${EXPECTED} expected)
+string(REPLACE "\r" "" expected "${expected}")
+string(REGEX REPLACE "\n$" "" expected "${expected}")
+if(NOT actual STREQUAL expected)
+    message(FATAL_ERROR "${SCRIPT} ${FLAGS}\nexpected:\n${expected}\ngot:\n${actual}")
+endif()